@@ -22,6 +22,7 @@ See the assignment specs for details ...
 #include <GL/glew.h> // for access to OpenGL API declarations 
 #include <glhelper.h>
 #include <glslshader.h> // GLSLShader class definition
+#include <glmesh.h> // OBJ meshes loaded through a binary cache
 #include <GLFW/glfw3.h> 
 #include <dpml.h>
 
@@ -127,7 +128,7 @@ struct GLPbo
       // coordinates which must then be
       // converted by you to RGB values
       std::vector<glm::vec2> tex; // not used in this submission
-      std::vector<unsigned short> tri; // triangle indices
+      std::vector<GLuint> tri; // triangle indices (32-bit)
       // window coordinates in array pd are obtained after NDC coordinates in
       // array pm are transformed by rotation transform followed by
       // viewport transformation matrix
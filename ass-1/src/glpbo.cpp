@@ -258,7 +258,7 @@ void GLPbo::init(GLsizei w, GLsizei h) {
         GLPbo::mdl.nml.clear();
         GLPbo::mdl.tex.clear();
         GLPbo::mdl.tri.clear();
-        if (DPML::parse_obj_mesh("../meshes/" + x + ".obj", mdl.pm, mdl.nml, mdl.tex, mdl.tri, true, true, true))
+        if (GLMesh::load("../meshes/" + x + ".obj", mdl.pm, mdl.nml, mdl.tex, mdl.tri))
         {
             for (auto& normal : mdl.nml)
             {
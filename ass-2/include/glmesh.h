@@ -0,0 +1,76 @@
+/* !
+@file		glmesh.h
+@author		benjaminzhiyuan.lee@digipen.edu
+@date		17/10/2026
+
+This file contains the declaration of structure GLMesh that loads the
+triangle meshes used by the graphics pipe emulator. The first time a Wavefront
+OBJ file is loaded, the parsed mesh is written next to it in a compiled binary
+format; later runs memory-map the binary file instead of parsing the text.
+OBJ files are parsed on multiple threads without iostreams.
+
+*//*__________________________________________________________________________*/
+
+/*                                                                      guard
+----------------------------------------------------------------------------- */
+#ifndef GLMESH_H
+#define GLMESH_H
+
+/*                                                                   includes
+----------------------------------------------------------------------------- */
+#include <GL/glew.h> // for GLuint
+#include "glm/glm.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*  _________________________________________________________________________ */
+struct GLMesh
+  /*! GLMesh structure to encapsulate loading of OBJ meshes through a binary
+  mesh cache.
+  A cache file has the path of its OBJ file with extension .bmsh and consists
+  of a Header followed by the arrays pm, nml, tex and tri stored one after the
+  other (structure of arrays). The header records the size and modification
+  time of the OBJ file so that a stale cache is rebuilt, and a checksum of
+  the arrays so that a damaged cache is never used.
+  */
+{
+  struct Header {
+    char magic[4];             // "BMSH"
+    std::uint32_t version;     // bumped whenever the layout or parser changes
+    std::uint64_t obj_size;    // size in bytes of the source OBJ file
+    std::int64_t obj_time;     // last write time of the source OBJ file
+    std::uint32_t vtx_cnt;     // number of elements in pm, nml and tex
+    std::uint32_t idx_cnt;     // number of elements in tri
+    std::uint32_t checksum;    // FNV-1a hash of everything after the header
+    std::uint32_t reserved;
+  };
+  static constexpr std::uint32_t version = 4;
+
+  // load the mesh in OBJ file obj_path into the given arrays - the binary
+  // cache is used when it is valid; otherwise the OBJ file is parsed by
+  // parse_obj(), optimized for the vertex cache and vertex fetch, and the
+  // cache is (re)written. Returns false if the OBJ file cannot be loaded.
+  static bool load(std::string const& obj_path,
+    std::vector<glm::vec3>& pm, std::vector<glm::vec3>& nml,
+    std::vector<glm::vec2>& tex, std::vector<GLuint>& tri);
+
+  // parse OBJ file obj_path into the given arrays like DPML::parse_obj_mesh()
+  // with every flag set: one vertex per distinct v/vt/vn tuple, per-vertex
+  // normals computed when the file has none, and positions centered on the
+  // model's origin and scaled to [-1, 1]
+  static bool parse_obj(std::string const& obj_path,
+    std::vector<glm::vec3>& pm, std::vector<glm::vec3>& nml,
+    std::vector<glm::vec2>& tex, std::vector<GLuint>& tri);
+
+  // reorder the triangles in tri for a post-transform vertex cache
+  static void optimize_vertex_cache(std::vector<GLuint>& tri, size_t vtx_cnt);
+  // renumber the vertices in the order that the triangles in tri use them
+  static void optimize_vertex_fetch(std::vector<glm::vec3>& pm, std::vector<glm::vec3>& nml,
+    std::vector<glm::vec2>& tex, std::vector<GLuint>& tri);
+
+  // path of the binary cache of obj_path
+  static std::string cache_path(std::string const& obj_path);
+};
+
+#endif /* GLMESH_H */
@@ -22,6 +22,10 @@ See the assignment specs for details ...
 #include <GL/glew.h> // for access to OpenGL API declarations 
 #include <glhelper.h>
 #include <glslshader.h> // GLSLShader class definition
+#include <glthreadpool.h> // worker threads that rasterize screen tiles
+#include <glmesh.h> // OBJ meshes loaded through a binary cache
+#include <gltexture.h> // mipmapped texture sampler
+#include <glprofiler.h> // per-stage frame timings
 #include <GLFW/glfw3.h> 
 #include <dpml.h>
 #include "glm/glm.hpp"
@@ -38,6 +42,7 @@ See the assignment specs for details ...
 #include <chrono>
 #include <cctype>
 #include <unordered_map>
+#include <span>
 
 /*  _________________________________________________________________________ */
 struct GLPbo
@@ -61,7 +66,9 @@ struct GLPbo
   static void draw_fullwindow_quad();
 
   // initialization and cleanup stuff ...
-  static void init(GLsizei w, GLsizei h);
+  // ring_depth is the number of PBOs that frames are rotated through
+  // headless renders into host memory without creating any GL object
+  static void init(GLsizei w, GLsizei h, GLuint ring_depth = 3, bool headless = false);
   static void setup_quad_vao();
   static void setup_shdrpgm();
   static void cleanup();
@@ -74,14 +81,37 @@ struct GLPbo
   // rather than computing these values many times, compute once in
   // GLPbo::init() and then forget ...
   static GLsizei pixel_cnt, byte_cnt; // how many pixels and bytes
-  // pointer to PBO's data store - must be set every frame with  
-  // the value returned by glMapNamedBuffer()
+  // pointer to the data store of the PBO that the current frame is written
+  // to - set every frame by emulate() to the persistent mapping of that PBO
   static Color *ptr_to_pbo;
 
+  // Ring of PBOs that are persistently mapped for writing. While the GPU
+  // copies frame N out of one PBO into the texture, the emulator writes
+  // frame N+1 into the next one; a fence per PBO tells emulate() when the
+  // GPU is done with a PBO so that it can be written again.
+  struct PboSlot {
+      GLuint id;                          // id for PBO
+      Color* ptr;                         // persistent mapping of PBO
+      GLsync fence;                       // signalled once GPU has read PBO
+      std::vector<unsigned char> painted; // blocks of PBO that may hold
+                                          // pixels other than clear color
+  };
+  static std::vector<PboSlot> pbo_ring;
+  static GLuint pbo_idx;       // slot written by the current frame
+  static double pbo_wait_ms;   // time the current frame waited on the fence
+
+  // Headless backend: frames are rendered into host framebuffer host_fb
+  // instead of a PBO, so neither a window nor a GL context is needed. This
+  // lets the emulator run on machines without a GPU ...
+  static bool is_headless;
+  static std::vector<Color> host_fb;
+
+  // write the last frame to a PNG (pathname ends in .png) or PPM file
+  static bool save_frame(std::string const& pathname);
+
   // geometry and material information ...
   static GLuint vaoid;        // with GL 4.5, VBO & EBO are not required
   static GLuint elem_cnt;     // how many indices in element buffer
-  static GLuint pboid;        // id for PBO
   static GLuint texid;        // id for texture object
   static GLSLShader shdr_pgm; // object that abstracts away nitty-gritty
                               // details of shader management
@@ -93,8 +123,10 @@ struct GLPbo
   static void set_clear_color(GLPbo::Color);
   static void set_clear_color(GLubyte r, GLubyte g, GLubyte b, GLubyte a = 255);
 
-  // akin to glClear(GL_COLOR_BUFFER_BIT) - uses the pointer ptr_to_pbo
-  // to get access to the PBO's data store ...
+  // akin to glClear(GL_COLOR_BUFFER_BIT) and glClear(GL_DEPTH_BUFFER_BIT) -
+  // both clears are deferred: they only flag the screen blocks that need
+  // clearing and the pixels are written when a block is first drawn to, or
+  // by resolve_tile() for blocks that nothing was drawn to ...
   static void clear_color_buffer();
   static void clear_depth_buffer();
 
@@ -121,6 +153,22 @@ struct GLPbo
     }
   };
 
+  // Window coordinates of a model's vertices stored as a structure of
+  // arrays: the vertex transform streams into three separate arrays and
+  // operator[] gathers a vertex for the triangle loops. The arrays are sized
+  // once when the model is loaded and are then only overwritten.
+  struct VertexArray {
+      std::vector<float> x, y, z;
+
+      void resize(size_t n) { x.resize(n); y.resize(n); z.resize(n); }
+      void assign(std::vector<glm::vec3> const& v) {
+          resize(v.size());
+          for (size_t i = 0; i < v.size(); ++i) { x[i] = v[i].x; y[i] = v[i].y; z[i] = v[i].z; }
+      }
+      size_t size() const { return x.size(); }
+      glm::vec3 operator[](size_t i) const { return glm::vec3(x[i], y[i], z[i]); }
+  };
+
   // Data structure to store vertex position and triangle index arrays
 // returned by DPML::parse_obj_mesh()
   struct Model {
@@ -131,14 +179,32 @@ struct GLPbo
       // coordinates which must then be
       // converted by you to RGB values
       std::vector<glm::vec2> tex; // not used in this submission
-      std::vector<unsigned short> tri; // triangle indices
-      // window coordinates in array pd are obtained after NDC coordinates in
-      // array pm are transformed by rotation transform followed by
-      // viewport transformation matrix
-      std::vector<glm::vec3> pd;
+      std::vector<GLuint> tri; // triangle indices (32-bit)
+      // copies of pm and nml as structures of arrays that are read by the
+      // vertex and lighting stages
+      VertexArray ps;
+      VertexArray ns;
+      // unit normal and centroid of each triangle in model coordinates,
+      // computed once when the model is loaded
+      std::vector<glm::vec3> fn, fc;
 
-      bool rotating = false;
-      float angle = 0.0f;
+      // Triangles are grouped into clusters of cluster_tris consecutive
+      // triangles when the model is loaded. Every frame, the planes that
+      // bound the viewport and the depth range are brought into the model
+      // coordinates of each instance (Instance::frustum) and clusters whose
+      // bounding sphere is outside any of them are culled by
+      // cull_triangles() without looking at any of their triangles.
+      struct Cluster {
+          GLuint first, count;   // offset into tri and number of indices
+          glm::vec3 center;      // bounding sphere in model coordinates
+          float radius;
+      };
+      std::vector<Cluster> clusters;
+      // bounding sphere of the whole model, used to cull entire instances
+      glm::vec3 center{};
+      float radius{};
+
+      // shading modes that an instance of the model can be drawn with
       enum class task {
           wireframe = 0,
           depth,
@@ -147,14 +213,165 @@ struct GLPbo
           textured,
           faceted_tex,
           smooth_tex,
-      } Tasking = GLPbo::Model::task::wireframe;
+      };
+  };
+  static Model mdl;
 
+  // An instance of a model in the scene. The model's mesh is shared by all
+  // of its instances; each instance has its own transform, shading mode and
+  // texture, and its own copy of the arrays written by the vertex stage.
+  // Instances are loaded from a scene file by load_scene().
+  struct Instance {
+      std::string name;          // name of the model
+      Model const* model;
+      GLTexture const* texture;  // texture of the textured shading modes
+      Model::task Tasking = Model::task::wireframe;
+      glm::vec3 position{};      // world coordinates of the model's origin
+      float scale = 1.0f;
+      bool rotating = false;
+      float angle = 0.0f;        // degrees about the rotation axis
+      float spin = 1.0f;         // degrees per frame while rotating
+
+      // Written every frame by viewport_xform(). Instances whose bounding
+      // sphere is outside the view volume are not visible and none of their
+      // per-vertex arrays are written.
+      bool visible = false;
       glm::mat3 ModelTrans{};
-      
-     
+      // matrix that maps model coordinates to clip coordinates with the
+      // viewport transform applied - dividing by w gives window coordinates
+      glm::mat4 xform{};
+      // unit normal (xyz) and offset (w) of each plane; points p inside the
+      // view volume have dot(normal, p) + offset >= 0 for every plane
+      glm::vec4 frustum[6]{};
+      // window coordinates in array pd are obtained after model coordinates
+      // in array ps are transformed by the instance's transform followed by
+      // the view chain
+      VertexArray pd;
+      std::vector<float> pw;         // reciprocal of clip coordinate w
+      std::vector<unsigned char> oc; // outcode of each vertex
+      // lighting computed once per frame by setup_lighting(): the light
+      // position in model coordinates and, for the smooth shading modes,
+      // the diffuse term of every vertex
+      glm::dvec3 light{};
+      std::vector<float> vd;
   };
-  static Model mdl;
-     static void viewport_xform(Model& model);
+  static std::vector<Instance> instances;
+  static GLuint current_instance; // instance selected by the M key
+  // replace the scene by the instances of scene file ../scenes/<name>.scn,
+  // loading the models and textures it names that are not loaded yet
+  static bool load_scene(std::string const& name);
+
+  // Camera that the view chain is built from. The orthographic projection
+  // has a view volume of height top - bottom and the perspective projection
+  // a vertical field of view of fovy degrees; both keep the aspect ratio of
+  // the window. Points between near_plane and far_plane in front of eye
+  // are visible.
+  struct Camera {
+      enum class Projection { orthographic, perspective };
+      Projection projection;
+      glm::vec3 eye, target, up;
+      float near_plane, far_plane;
+      float top, bottom; // orthographic projection
+      float fovy;        // perspective projection
+  };
+  static Camera camera;
+  // replace the camera and rebuild the view chain - may be called at any time
+  static void set_camera(Camera const& cam);
+  static constexpr GLuint cluster_tris = 128;
+  // split the triangles of model into clusters and compute its bounding
+  // sphere - called once per model
+  static void build_clusters(Model& model);
+  // compute the face normals and centroids of model - called once per model
+  static void build_faces(Model& model);
+  // per-frame lighting: move the light into the model space of every
+  // visible instance and, if its shading mode needs them, compute the
+  // per-vertex diffuse terms
+  static void setup_lighting();
+  // diffuse terms of vertices [first, last) of an instance - vectorized and
+  // called by setup_lighting() on worker threads
+  static void light_vertices(Instance& inst, size_t first, size_t last);
+  // select the shading mode of every instance in the scene
+  static void set_render_mode(Model::task task);
+
+  // A triangle of the scene: offset tri into Model::tri of the model of
+  // instance inst (an index into instances).
+  struct TriRef {
+      GLuint inst, tri;
+  };
+
+  // The framebuffer is split into square tiles of tile_size x tile_size
+  // pixels. Every frame, front-facing triangles are first binned into each
+  // tile their bounding box overlaps and every tile is then rasterized by
+  // exactly one worker thread. Since a tile's pixels in the PBO and depth
+  // buffer are owned by a single worker, the pixel path needs no locks.
+  // Both lists of a tile are sorted by instance, since triangles are binned
+  // in the order of the instances.
+  struct Tile {
+      GLint x0, y0, x1, y1;        // pixel bounds [x0, x1) x [y0, y1)
+      std::vector<TriRef> tris;    // binned triangles
+      std::vector<GLuint> clipped; // indices into clipped_tris of binned pieces
+  };
+  static constexpr GLint tile_size = 64;
+  static GLint tiles_x, tiles_y; // number of tiles along each axis
+  static std::vector<Tile> tiles;
+
+  // Triangles that cross the near or far plane (NDC z of -1 and 1) or leave
+  // the guard band of +/- guard_band pixels around the window origin are
+  // clipped in homogeneous clip coordinates when they are binned, so that
+  // vertices behind the eye are handled too. The clipped polygon is split
+  // into a fan of triangles whose vertices are stored as barycentric weights
+  // w of the source triangle at offset tri in Model::tri, so that
+  // draw_tile() can interpolate any vertex attribute of the pieces, along
+  // with their window coordinates and reciprocal clip w in p.
+  static constexpr double guard_band = 8192.0;
+  // outcode bits set by the vertex stage for each clipping plane that a
+  // vertex lies outside of
+  enum : unsigned char {
+      clip_near = 1, clip_far = 2,
+      clip_left = 4, clip_right = 8,
+      clip_bottom = 16, clip_top = 32,
+  };
+  struct ClippedTri {
+      GLuint inst, tri;
+      glm::dvec3 w[3];
+      glm::dvec4 p[3];
+  };
+  static std::vector<ClippedTri> clipped_tris;
+
+  // carve the framebuffer into tiles - called once by init()
+  static void setup_tiles();
+  // Culling stage that runs before binning: worker threads classify every
+  // triangle of the visible instances as visible, back-facing, zero-area
+  // (seen edge-on) or off-screen, and the visible triangles of the whole
+  // scene are compacted into visible_tris with a parallel prefix sum.
+  // Binning and the wireframe mode only ever look at visible_tris.
+  struct CullStats {
+      GLuint visible, backfaced, zero_area, offscreen; // triangle counts
+      GLuint clusters;                                 // clusters culled
+      GLuint instances;                                // instances culled
+  };
+  static CullStats cull_stats; // counts of the current frame
+  static std::vector<TriRef> visible_tris;
+  static void cull_triangles();
+  // bin every triangle in visible_tris that is not drawn as a wireframe into
+  // the tiles it overlaps
+  static void bin_triangles();
+  // clip triangle at offset tri in Model::tri of instance inst and append the
+  // pieces that remain inside the clipping planes to clipped_tris
+  static void clip_triangle(GLuint inst, GLuint tri);
+  // rasterize all triangles binned into tile, each with the shading mode of
+  // its instance
+  static void rasterize_tile(Tile const& tile);
+  // write the clear color to blocks of tile that are still pending a clear
+  static void resolve_tile(Tile const& tile);
+
+     // compute the transform of every instance, cull instances outside the
+     // view volume and run the vertex stage for the others
+     static void viewport_xform();
+     // vertex stage: transform vertices [first, last) of the model's array ps
+     // by the instance's xform and divide by w into pd, pw and oc -
+     // vectorized and called by viewport_xform() on worker threads
+     static void transform_vertices(Instance& inst, size_t first, size_t last);
      static void set_pixel(int x, int y, GLPbo::Color draw_clr);
 
     // set all pixels with same color draw_clr on line segment starting
@@ -163,53 +380,22 @@ struct GLPbo
         static void render_linebresenham(GLint x1, GLint y1,
       GLint x2, GLint y2, GLPbo::Color draw_clr);
 
-    // Implements a flat shaded triangle rasterizer using edge equations
-    // and top-left tie-breaking rule.
-    // Whether fragment (x, y) is rasterized or not is based on the results of
-    // point sampling the fragment at its center (x+0.5, y+0.5).
-    // Top left tie-breaking rule must be implemented.
-    // Parameters p0, p1, and p2 represent vertices of triangle whose x- and y
-    // values are specified in window coordinates.
-    // Front-facing triangles are assumed to have counterclockwise winding.
-    // Back-facing triangles must be culled.
-    // The clr parameter is specified by the caller with randomly generated
-    // color coordinates in range [0, 1].
-    // The function returns false if the triangle is back-facing; otherwise
-    // the function returns true.
-        static bool render_faceted_shading(glm::dvec3 const& p0, glm::dvec3 const& p1,
-            glm::dvec3 const& p2, glm::dvec3 const& m0, glm::dvec3 const& m1, glm::dvec3 const& m2);
-
-    // Implements a smooth shaded triangle rasterizer using edge equations,
-    // top-left tie-breaking rule, and Barycentric interpolation.
-    // Parameters p0, p1, and p2 represent vertices of triangle whose x- and y-
-    // values are specified in window coordinates.
-    // Front-facing triangles are assumed to have counterclockwise winding.
-    // Back-facing triangles must be culled.
-    // Parameters c0, c1, and c2 represent RGB color coordinates for vertices
-    // p0, p1, and p2, respectively. Color coordinates are specified in
-    // range [0, 1].
-    // The function returns false if the triangle is back-facing; otherwise
-    // the function returns true.
-        static bool render_shadow_map(glm::dvec3 const& p0, glm::dvec3 const& p1,
-            glm::dvec3 const& p2);
-
-        static bool render_smooth_shading(glm::dvec3 const& p0, glm::dvec3 const& p1, glm::dvec3 const& p2, 
-            glm::vec3 const& m0, glm::vec3 const& m1, glm::vec3 const& m2,
-            glm::dvec3 const& n0, glm::dvec3 const& n1, glm::dvec3 const& n2);
-
-        static void setup_texobj(std::string pathname);
-
-        static bool render_texture_map(glm::dvec3 const& p0, glm::dvec3 const& p1, glm::dvec3 const& p2
-            , glm::dvec2 const& tx0, glm::dvec2 const& tx1, glm::dvec2 const& tx2);
-
-        static bool render_faceted_texture(glm::dvec3 const& p0, glm::dvec3 const& p1, glm::dvec3 const& p2
-            , glm::dvec3 const& m0, glm::dvec3 const& m1, glm::dvec3 const& m2,
-            glm::dvec2 const& tx0, glm::dvec2 const& tx1, glm::dvec2 const& tx2);
-
-        static bool render_smooth_texture(glm::dvec3 const& p0, glm::dvec3 const& p1, glm::dvec3 const& p2
-            , glm::vec3 const& m0, glm::vec3 const& m1, glm::vec3 const& m2,
-            glm::dvec3 const& n0, glm::dvec3 const& n1, glm::dvec3 const& n2,
-            glm::dvec2 const& tx0, glm::dvec2 const& tx1, glm::dvec2 const& tx2);
+    // Single triangle setup and traversal loop shared by every shading mode.
+    // Triangles are rasterized with edge equations and the top-left
+    // tie-breaking rule by point sampling fragments at their centers; only
+    // fragments inside tile are rasterized and depth tested.
+    // Shader is a compile-time fragment shading policy (see namespace SHADER
+    // in glpbo.cpp) whose constexpr flags select the vertex attributes to
+    // fetch and whose begin() and shade() functions compute per-triangle
+    // and per-fragment values - there is no per-triangle switch on the mode.
+    // tris and clipped are the runs of the tile's lists that belong to inst.
+        template <typename Shader>
+        static void draw_tile(Tile const& tile, Instance const& inst,
+            std::span<TriRef const> tris, std::span<GLuint const> clipped);
+
+        // texture ../images/<pathname>.tex, loaded by the first call - nullptr
+        // if the file cannot be read
+        static GLTexture const* setup_texobj(std::string pathname);
 };
 
 #endif /* GLPBO_H */
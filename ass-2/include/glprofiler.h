@@ -0,0 +1,109 @@
+/* !
+@file		glprofiler.h
+@author		benjaminzhiyuan.lee@digipen.edu
+@date		17/10/2026
+
+This file contains the declaration of structure GLProfiler that times the
+stages of the graphics pipe emulator. CPU stages are timed by scoped timers,
+GPU stages by OpenGL timer queries, and the timings of the most recent
+frames are kept in a ring buffer from which statistics are computed and
+exported.
+
+*//*__________________________________________________________________________*/
+
+/*                                                                      guard
+----------------------------------------------------------------------------- */
+#ifndef GLPROFILER_H
+#define GLPROFILER_H
+
+/*                                                                   includes
+----------------------------------------------------------------------------- */
+#include <GL/glew.h> // for GLuint and the timer queries
+#include <chrono>
+#include <iosfwd>
+#include <string>
+
+/*  _________________________________________________________________________ */
+struct GLProfiler
+  /*! GLProfiler structure to encapsulate the per-stage timings of the frames
+  of the emulator. Every frame starts with begin_frame(); stage times are
+  added to the open frame, which is stored in a ring of history frames when
+  the next frame begins (or end_frame() is called). Times are in
+  milliseconds.
+  */
+{
+  enum Stage : GLuint {
+      frame,          // from one begin_frame() to the next
+      emulate,        // all of GLPbo::emulate()
+      pbo_wait,       // waiting for the GPU to release the next PBO
+      clear,          // color and depth buffer clears
+      vertex,         // transforms, instance culling and the vertex stage
+      cull,           // triangle culling and compaction
+      lighting,       // per-frame lighting
+      bin,            // binning and clipping
+      raster,         // rasterizing all tiles (wall time)
+      // worker time spent rasterizing each shading mode, summed over all
+      // threads - in the order of GLPbo::Model::task
+      raster_wireframe,
+      raster_depth,
+      raster_faceted,
+      raster_shaded,
+      raster_textured,
+      raster_faceted_tex,
+      raster_smooth_tex,
+      upload,         // issuing the copy of the PBO to the texture
+      present,        // CPU side of GLPbo::draw_fullwindow_quad()
+      gpu_upload,     // GPU time of the copy of the PBO to the texture
+      gpu_quad,       // GPU time of drawing the full-window quad
+      stage_count
+  };
+  static constexpr GLuint history = 256; // frames kept in the ring
+
+  // timer that adds the time from its construction to its destruction to
+  // stage of the open frame - may be used by any thread
+  struct Scope {
+      explicit Scope(Stage s) : stage{ s }, start{ std::chrono::steady_clock::now() } {}
+      ~Scope() { add(stage, std::chrono::steady_clock::now() - start); }
+      Scope(Scope const&) = delete;
+      Scope& operator=(Scope const&) = delete;
+
+      Stage stage;
+      std::chrono::steady_clock::time_point start;
+  };
+
+  // close the open frame, if any, and open a new one
+  static void begin_frame();
+  // close the open frame
+  static void end_frame();
+  // add time t to stage of the open frame - thread-safe
+  static void add(Stage stage, std::chrono::steady_clock::duration t);
+
+  // create the timer queries of the GPU stages - needs an OpenGL context
+  static void init_gpu();
+  static void cleanup_gpu();
+  // bracket the OpenGL commands of a GPU stage. Results are read a few
+  // frames later, when they are available without stalling, and are added
+  // to the frame that is open at that time.
+  static void gpu_begin(Stage stage);
+  static void gpu_end(Stage stage);
+
+  struct Stats {
+      double min, avg, p99;
+  };
+  // number of frames in the ring
+  static GLuint frames();
+  // statistics of stage over the frames in the ring
+  static Stats stats(Stage stage);
+  // time of stage in the most recent frame in the ring
+  static double last(Stage stage);
+  static char const* name(Stage stage);
+
+  // one row per frame in the ring (oldest first), one column per stage
+  static bool write_csv(std::string const& pathname);
+  // statistics and frame times of every stage
+  static bool write_json(std::string const& pathname);
+  // table of the statistics of every stage
+  static void print(std::ostream& os);
+};
+
+#endif /* GLPROFILER_H */
@@ -0,0 +1,88 @@
+/* !
+@file		gltexture.h
+@author		benjaminzhiyuan.lee@digipen.edu
+@date		17/10/2026
+
+This file contains the declaration of structure GLTexture that samples the
+texture images used by the graphics pipe emulator. A texture keeps a full
+mip chain so that minified textures are filtered instead of aliasing, and
+stores its texels as packed 8-bit RGBA in a tiled, Morton-ordered layout.
+
+*//*__________________________________________________________________________*/
+
+/*                                                                      guard
+----------------------------------------------------------------------------- */
+#ifndef GLTEXTURE_H
+#define GLTEXTURE_H
+
+/*                                                                   includes
+----------------------------------------------------------------------------- */
+#include <GL/glew.h> // for GLint
+#include "glm/glm.hpp"
+#include <string>
+#include <vector>
+
+/*  _________________________________________________________________________ */
+struct GLTexture
+  /*! GLTexture structure to encapsulate a mipmapped texture image and the
+  sampler state used to read it. Sampled colors have channels in range
+  [0, 255]. Texture coordinates address texel centers at ((i + 0.5) / width,
+  (j + 0.5) / height) like OpenGL. The wrap and filter modes belong to the
+  texture; scene files select them with a texture line (see
+  GLPbo::load_scene()).
+  Every level is split into tiles of tile_size x tile_size texels stored one
+  after the other in row-major order; the texels of a tile are stored in
+  Morton (Z) order, so the 2 x 2 footprint of a bilinear fetch nearly always
+  lies within one or two cache lines. Levels of any size are padded to whole
+  tiles.
+  */
+{
+  enum class Wrap {
+      clamp,   // coordinates are clamped to the edge texels
+      repeat,  // the texture is tiled
+  };
+  enum class Filter {
+      nearest,   // nearest texel of level 0
+      bilinear,  // bilinear filtering in the nearest mip level
+      trilinear, // bilinear filtering in the two nearest mip levels
+  };
+
+  static constexpr GLint tile_size = 8;
+  struct Level {
+      GLint width, height;
+      GLint tiles_x;               // number of tiles per row of tiles
+      std::vector<GLuint> texels;  // RGBA8 with red in the lowest byte
+  };
+  std::vector<Level> levels; // levels[0] is the full-resolution image
+  Wrap wrap{ Wrap::clamp };
+  Filter filter{ Filter::trilinear };
+
+  // load a .tex file - a header of three 32-bit integers (width, height
+  // and bytes per texel: 3 for RGB, 4 for RGBA) followed by the texels in
+  // row-major order - with a single read and build its mip chain. Headerless
+  // 256 x 256 RGBA files of the tutorials are accepted too. Returns false if
+  // the file cannot be read or is malformed.
+  bool load(std::string const& pathname);
+
+  // make texels (width x height, row-major RGBA8) level 0 and build the rest
+  // of the mip chain down to 1 x 1 by averaging blocks of 2 x 2 texels
+  void build(GLint width, GLint height, std::vector<GLuint> const& texels);
+
+  // level of detail for the texture coordinate derivatives along window x
+  // (dx) and window y (dy). The rasterizer calls it once per triangle when
+  // the derivatives are constant across it and once per fragment otherwise.
+  float lod(glm::vec2 const& dx, glm::vec2 const& dy) const;
+
+  // filtered color at texture coordinates uv and level of detail lod
+  glm::vec3 sample(glm::vec2 const& uv, float lod) const;
+
+private:
+  // offset in Level::texels of texel (x, y)
+  static size_t offset(Level const& level, GLint x, GLint y);
+  // texel (x, y) of level after applying the wrap mode
+  glm::vec3 texel(Level const& level, GLint x, GLint y) const;
+  // bilinearly filtered color of level at texture coordinates uv
+  glm::vec3 bilinear(Level const& level, glm::vec2 const& uv) const;
+};
+
+#endif /* GLTEXTURE_H */
@@ -267,6 +267,12 @@ void GLHelper::key_cb(GLFWwindow* pwin, int key, int scancode, int
         else if (key == GLFW_KEY_L) {
             keystateL = GL_TRUE;
         }
+        else if (key == GLFW_KEY_P) {
+            keystateP = GL_TRUE;
+        }
+        else if (key == GLFW_KEY_T) {
+            keystateT = GL_TRUE;
+        }
      
     }
     else if (GLFW_REPEAT == action) {
@@ -295,6 +301,12 @@ void GLHelper::key_cb(GLFWwindow* pwin, int key, int scancode, int
         else if (key == GLFW_KEY_L) {
             keystateL = GL_FALSE;
         }
+        else if (key == GLFW_KEY_P) {
+            keystateP = GL_FALSE;
+        }
+        else if (key == GLFW_KEY_T) {
+            keystateT = GL_FALSE;
+        }
     }
 }
 
@@ -0,0 +1,924 @@
+/*!
+@file		glmesh.cpp
+@author		benjaminzhiyuan.lee@digipen.edu
+@date		17/10/2026
+
+This file implements structure GLMesh. Binary mesh caches are memory-mapped
+read-only (MapViewOfFile on Windows, mmap elsewhere) and their arrays are
+copied into the caller's vectors with a single memcpy each.
+OBJ files are read into memory with a single read, cut into chunks at line
+boundaries and the chunks are parsed with std::from_chars on one thread each;
+the per-chunk arrays are then merged and the v/vt/vn tuples deduplicated.
+Before a parsed mesh is cached, its triangles are reordered for the
+post-transform vertex cache with Tom Forsyth's linear-speed algorithm and its
+vertices are renumbered in the order that the triangles first use them.
+
+*//*__________________________________________________________________________*/
+
+/*                                                                   includes
+----------------------------------------------------------------------------- */
+#include <glmesh.h>
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static_assert(sizeof(GLMesh::Header) == 40, "mesh cache header must not contain padding");
+static_assert(sizeof(glm::vec3) == 12 && sizeof(glm::vec2) == 8, "vertex attributes must be tightly packed");
+
+/*                                                   objects with file scope
+----------------------------------------------------------------------------- */
+namespace
+{
+    /*  _____________________________________________________________________ */
+    class MappedFile
+      /*! Read-only memory mapping of a whole file. data() is nullptr if the
+      file does not exist or cannot be mapped.
+      */
+    {
+    public:
+        explicit MappedFile(std::string const& path)
+        {
+#ifdef _WIN32
+            file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE)
+            {
+                return;
+            }
+            LARGE_INTEGER sz;
+            if (!GetFileSizeEx(file, &sz) || sz.QuadPart == 0)
+            {
+                return;
+            }
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (!mapping)
+            {
+                return;
+            }
+            ptr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            len = ptr ? static_cast<size_t>(sz.QuadPart) : 0;
+#else
+            fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+            {
+                return;
+            }
+            struct stat st;
+            if (fstat(fd, &st) != 0 || st.st_size == 0)
+            {
+                return;
+            }
+            void* p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED)
+            {
+                return;
+            }
+            ptr = p;
+            len = static_cast<size_t>(st.st_size);
+#endif
+        }
+
+        ~MappedFile()
+        {
+#ifdef _WIN32
+            if (ptr)
+            {
+                UnmapViewOfFile(ptr);
+            }
+            if (mapping)
+            {
+                CloseHandle(mapping);
+            }
+            if (file != INVALID_HANDLE_VALUE)
+            {
+                CloseHandle(file);
+            }
+#else
+            if (ptr)
+            {
+                munmap(ptr, len);
+            }
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+#endif
+        }
+
+        MappedFile(MappedFile const&) = delete;
+        MappedFile& operator=(MappedFile const&) = delete;
+
+        unsigned char const* data() const { return static_cast<unsigned char const*>(ptr); }
+        size_t size() const { return len; }
+
+    private:
+#ifdef _WIN32
+        HANDLE file{ INVALID_HANDLE_VALUE };
+        HANDLE mapping{ nullptr };
+#else
+        int fd{ -1 };
+#endif
+        void* ptr{ nullptr };
+        size_t len{ 0 };
+    };
+
+    /**
+    @brief Continues a 32-bit FNV-1a hash over a block of bytes.
+
+    @param hash The hash of the preceding bytes.
+    @param data The bytes to hash.
+    @param size The number of bytes.
+    @return The updated hash.
+    */
+    std::uint32_t fnv1a(std::uint32_t hash, void const* data, size_t size)
+    {
+        unsigned char const* p = static_cast<unsigned char const*>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash = (hash ^ p[i]) * 16777619u;
+        }
+        return hash;
+    }
+    constexpr std::uint32_t fnv1a_basis = 2166136261u;
+
+    /**
+    @brief Copies count elements from a mapped cache into a vector.
+
+    @param src Position in the mapped cache; advanced past the elements.
+    @param dst The vector to fill.
+    @param count The number of elements.
+    */
+    template <typename T>
+    void copy_array(unsigned char const*& src, std::vector<T>& dst, size_t count)
+    {
+        dst.resize(count);
+        std::memcpy(dst.data(), src, count * sizeof(T));
+        src += count * sizeof(T);
+    }
+
+    /**
+    @brief Loads a mesh from its binary cache.
+
+    @param path The path of the cache.
+    @param obj_size The size of the source OBJ file.
+    @param obj_time The last write time of the source OBJ file.
+    @return True if the cache exists, matches the OBJ file and its checksum;
+    false otherwise, in which case the arrays are left unspecified.
+    */
+    bool read_cache(std::string const& path, std::uint64_t obj_size, std::int64_t obj_time,
+        std::vector<glm::vec3>& pm, std::vector<glm::vec3>& nml,
+        std::vector<glm::vec2>& tex, std::vector<GLuint>& tri)
+    {
+        MappedFile file(path);
+        if (!file.data() || file.size() < sizeof(GLMesh::Header))
+        {
+            return false;
+        }
+
+        GLMesh::Header hdr;
+        std::memcpy(&hdr, file.data(), sizeof(hdr));
+        if (std::memcmp(hdr.magic, "BMSH", 4) != 0 || hdr.version != GLMesh::version
+            || hdr.obj_size != obj_size || hdr.obj_time != obj_time)
+        {
+            return false;
+        }
+        size_t vtx_bytes = static_cast<size_t>(hdr.vtx_cnt) * (2 * sizeof(glm::vec3) + sizeof(glm::vec2));
+        size_t idx_bytes = static_cast<size_t>(hdr.idx_cnt) * sizeof(GLuint);
+        if (file.size() != sizeof(hdr) + vtx_bytes + idx_bytes)
+        {
+            return false;
+        }
+        unsigned char const* src = file.data() + sizeof(hdr);
+        if (fnv1a(fnv1a_basis, src, vtx_bytes + idx_bytes) != hdr.checksum)
+        {
+            return false;
+        }
+
+        copy_array(src, pm, hdr.vtx_cnt);
+        copy_array(src, nml, hdr.vtx_cnt);
+        copy_array(src, tex, hdr.vtx_cnt);
+        copy_array(src, tri, hdr.idx_cnt);
+        return true;
+    }
+
+    /**
+    @brief Writes the binary cache of a mesh.
+    The cache is written to a temporary file that is then renamed, so that a
+    concurrent or interrupted run never sees a partial cache.
+
+    @param path The path of the cache.
+    @param obj_size The size of the source OBJ file.
+    @param obj_time The last write time of the source OBJ file.
+    @return True if the cache was written; false otherwise.
+    */
+    bool write_cache(std::string const& path, std::uint64_t obj_size, std::int64_t obj_time,
+        std::vector<glm::vec3> const& pm, std::vector<glm::vec3> const& nml,
+        std::vector<glm::vec2> const& tex, std::vector<GLuint> const& tri)
+    {
+        GLMesh::Header hdr{};
+        std::memcpy(hdr.magic, "BMSH", 4);
+        hdr.version = GLMesh::version;
+        hdr.obj_size = obj_size;
+        hdr.obj_time = obj_time;
+        hdr.vtx_cnt = static_cast<std::uint32_t>(pm.size());
+        hdr.idx_cnt = static_cast<std::uint32_t>(tri.size());
+        std::uint32_t hash = fnv1a_basis;
+        hash = fnv1a(hash, pm.data(), pm.size() * sizeof(glm::vec3));
+        hash = fnv1a(hash, nml.data(), nml.size() * sizeof(glm::vec3));
+        hash = fnv1a(hash, tex.data(), tex.size() * sizeof(glm::vec2));
+        hash = fnv1a(hash, tri.data(), tri.size() * sizeof(GLuint));
+        hdr.checksum = hash;
+
+        std::string tmp = path + ".tmp";
+        {
+            std::ofstream ofs{ tmp, std::ios::binary | std::ios::trunc };
+            if (!ofs)
+            {
+                return false;
+            }
+            ofs.write(reinterpret_cast<char const*>(&hdr), sizeof(hdr));
+            ofs.write(reinterpret_cast<char const*>(pm.data()), pm.size() * sizeof(glm::vec3));
+            ofs.write(reinterpret_cast<char const*>(nml.data()), nml.size() * sizeof(glm::vec3));
+            ofs.write(reinterpret_cast<char const*>(tex.data()), tex.size() * sizeof(glm::vec2));
+            ofs.write(reinterpret_cast<char const*>(tri.data()), tri.size() * sizeof(GLuint));
+            if (!ofs)
+            {
+                return false;
+            }
+        }
+        std::error_code ec;
+        std::filesystem::rename(tmp, path, ec);
+        if (ec)
+        {
+            std::filesystem::remove(tmp, ec);
+            return false;
+        }
+        return true;
+    }
+
+    // OBJ files smaller than this are parsed by a single thread
+    constexpr size_t min_chunk_bytes = 64 * 1024;
+
+    /*  _____________________________________________________________________ */
+    struct Corner
+      /*! One corner of a face as (position, texcoord, normal) indices into the
+      merged attribute arrays; -1 marks an absent texcoord or normal. Indices
+      are relative to the first attribute of the chunk when the matching bit
+      of rel is set (negative OBJ indices, or any index of a chunk whose
+      preceding chunks have not been counted yet).
+      */
+    {
+        int v, t, n;
+        unsigned char rel;
+    };
+
+    /*  _____________________________________________________________________ */
+    struct Chunk
+      /*! Attributes and triangulated face corners parsed from one chunk of an
+      OBJ file.
+      */
+    {
+        std::vector<glm::vec3> v;
+        std::vector<glm::vec2> vt;
+        std::vector<glm::vec3> vn;
+        std::vector<Corner> corners; // three per triangle
+        bool ok{ true };
+    };
+
+    bool is_blank(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    char const* skip_blanks(char const* p, char const* end)
+    {
+        while (p < end && is_blank(*p))
+        {
+            ++p;
+        }
+        return p;
+    }
+
+    /**
+    @brief Parses up to count floats separated by blanks.
+
+    @param p Position in the chunk; advanced past the parsed floats.
+    @param end End of the current line.
+    @param out Receives the floats.
+    @param count The number of floats to parse.
+    @return True if all count floats were parsed.
+    */
+    bool parse_floats(char const*& p, char const* end, float* out, int count)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            p = skip_blanks(p, end);
+            if (p < end && *p == '+')
+            {
+                ++p;
+            }
+            std::from_chars_result r = std::from_chars(p, end, out[i]);
+            if (r.ec != std::errc{})
+            {
+                return false;
+            }
+            p = r.ptr;
+        }
+        return true;
+    }
+
+    /**
+    @brief Parses one v, v/t, v//n or v/t/n face vertex.
+
+    @param p Position in the chunk; advanced past the face vertex.
+    @param end End of the current line.
+    @param vcnt, tcnt, ncnt Number of attributes of each kind parsed so far
+    in this chunk, used to resolve negative indices.
+    @param c Receives the corner.
+    @return True if a face vertex was parsed.
+    */
+    bool parse_corner(char const*& p, char const* end, int vcnt, int tcnt, int ncnt, Corner& c)
+    {
+        int idx[3]{ 0, 0, 0 };
+        for (int k = 0; k < 3; ++k)
+        {
+            if (k > 0)
+            {
+                if (p >= end || *p != '/')
+                {
+                    break;
+                }
+                ++p;
+                if (p < end && *p == '/')
+                {
+                    continue; // v//n has no texcoord
+                }
+            }
+            std::from_chars_result r = std::from_chars(p, end, idx[k]);
+            if (r.ec != std::errc{} || idx[k] == 0)
+            {
+                return false;
+            }
+            p = r.ptr;
+        }
+
+        int cnt[3]{ vcnt, tcnt, ncnt };
+        int out[3];
+        c.rel = 0;
+        for (int k = 0; k < 3; ++k)
+        {
+            if (idx[k] > 0)
+            {
+                out[k] = idx[k] - 1;
+            }
+            else if (idx[k] < 0)
+            {
+                out[k] = cnt[k] + idx[k];
+                c.rel |= static_cast<unsigned char>(1 << k);
+            }
+            else
+            {
+                out[k] = -1;
+            }
+        }
+        c.v = out[0];
+        c.t = out[1];
+        c.n = out[2];
+        return true;
+    }
+
+    /**
+    @brief Parses the lines of an OBJ file in range [p, end).
+    Only v, vt, vn and f statements are used; every other statement is
+    skipped. Polygons are split into a fan of triangles.
+
+    @param p Start of the chunk; must be the start of a line.
+    @param end End of the chunk; must be the end of a line.
+    @param out Receives the parsed attributes and corners.
+    */
+    void parse_chunk(char const* p, char const* end, Chunk& out)
+    {
+        std::vector<Corner> poly;
+        while (p < end)
+        {
+            char const* eol = static_cast<char const*>(std::memchr(p, '\n', end - p));
+            if (!eol)
+            {
+                eol = end;
+            }
+            p = skip_blanks(p, eol);
+
+            if (eol - p > 1 && p[0] == 'v' && is_blank(p[1]))
+            {
+                p += 2;
+                glm::vec3 v;
+                out.ok = out.ok && parse_floats(p, eol, &v.x, 3);
+                out.v.push_back(v);
+            }
+            else if (eol - p > 2 && p[0] == 'v' && p[1] == 't' && is_blank(p[2]))
+            {
+                p += 3;
+                glm::vec2 vt;
+                out.ok = out.ok && parse_floats(p, eol, &vt.x, 2);
+                out.vt.push_back(vt);
+            }
+            else if (eol - p > 2 && p[0] == 'v' && p[1] == 'n' && is_blank(p[2]))
+            {
+                p += 3;
+                glm::vec3 vn;
+                out.ok = out.ok && parse_floats(p, eol, &vn.x, 3);
+                out.vn.push_back(vn);
+            }
+            else if (eol - p > 1 && p[0] == 'f' && is_blank(p[1]))
+            {
+                ++p;
+                poly.clear();
+                for (p = skip_blanks(p, eol); p < eol; p = skip_blanks(p, eol))
+                {
+                    Corner c;
+                    if (!parse_corner(p, eol, static_cast<int>(out.v.size()),
+                        static_cast<int>(out.vt.size()), static_cast<int>(out.vn.size()), c))
+                    {
+                        out.ok = false;
+                        break;
+                    }
+                    poly.push_back(c);
+                }
+                for (size_t i = 1; i + 1 < poly.size(); ++i)
+                {
+                    out.corners.push_back(poly[0]);
+                    out.corners.push_back(poly[i]);
+                    out.corners.push_back(poly[i + 1]);
+                }
+            }
+            p = eol + 1;
+        }
+    }
+
+    // simulated size of the post-transform vertex cache (LRU)
+    constexpr int vcache_size = 32;
+
+    /**
+    @brief Returns the Forsyth score of a vertex.
+    Vertices of the last triangle get a fixed score, other cached vertices a
+    score that decays with their age, and every vertex a boost that grows as
+    its number of remaining triangles drops so that lone triangles are not
+    left behind.
+
+    @param cache_pos Position of the vertex in the cache, or -1.
+    @param remaining Number of triangles using the vertex that are not yet
+    emitted.
+    @return The score of the vertex.
+    */
+    float vertex_score(int cache_pos, GLuint remaining)
+    {
+        if (remaining == 0)
+        {
+            return -1.0f;
+        }
+        float score = 0.0f;
+        if (cache_pos >= 0)
+        {
+            score = cache_pos < 3 ? 0.75f
+                : std::pow(1.0f - (cache_pos - 3) * (1.0f / (vcache_size - 3)), 1.5f);
+        }
+        return score + 2.0f / std::sqrt(static_cast<float>(remaining));
+    }
+
+    /**
+    @brief Reads a whole file into memory with a single read.
+
+    @param path The path of the file.
+    @param buf Receives the contents of the file.
+    @return True if the file was read.
+    */
+    bool read_file(std::string const& path, std::vector<char>& buf)
+    {
+        std::error_code ec;
+        std::uintmax_t size = std::filesystem::file_size(path, ec);
+        if (ec)
+        {
+            return false;
+        }
+        std::FILE* fp = std::fopen(path.c_str(), "rb");
+        if (!fp)
+        {
+            return false;
+        }
+        buf.resize(static_cast<size_t>(size));
+        size_t got = std::fread(buf.data(), 1, buf.size(), fp);
+        std::fclose(fp);
+        return got == buf.size();
+    }
+}
+
+/**
+@brief Parses an OBJ file on multiple threads.
+Every distinct (position, texcoord, normal) tuple referenced by a face
+becomes one vertex. If the file has no normals, each vertex gets the
+normalized sum of the (area-weighted) normals of the faces around its
+position; normals read from the file are normalized. Missing texture
+coordinates are set to (0, 0). Positions are finally centered on the
+center of the model's bounding box and scaled so that the model fits in
+[-1, 1] along its largest dimension.
+
+@param obj_path The path of the OBJ file.
+@param pm Receives the vertex positions.
+@param nml Receives the vertex normals.
+@param tex Receives the vertex texture coordinates.
+@param tri Receives the triangle indices.
+@return True if the file was parsed; false if it cannot be read or is
+malformed.
+*/
+bool GLMesh::parse_obj(std::string const& obj_path,
+    std::vector<glm::vec3>& pm, std::vector<glm::vec3>& nml,
+    std::vector<glm::vec2>& tex, std::vector<GLuint>& tri)
+{
+    std::vector<char> buf;
+    if (!read_file(obj_path, buf))
+    {
+        return false;
+    }
+    char const* const first = buf.data();
+    char const* const last = first + buf.size();
+
+    // cut the buffer into chunks that end right after a newline
+    size_t chunk_cnt = std::max<size_t>(1, std::thread::hardware_concurrency());
+    chunk_cnt = std::min(chunk_cnt, buf.size() / min_chunk_bytes + 1);
+    std::vector<char const*> bounds{ first };
+    for (size_t i = 1; i < chunk_cnt; ++i)
+    {
+        char const* p = first + buf.size() * i / chunk_cnt;
+        p = std::max(p, bounds.back());
+        char const* eol = static_cast<char const*>(std::memchr(p, '\n', last - p));
+        bounds.push_back(eol ? eol + 1 : last);
+    }
+    bounds.push_back(last);
+
+    std::vector<Chunk> chunks(chunk_cnt);
+    {
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < chunk_cnt; ++i)
+        {
+            threads.emplace_back(parse_chunk, bounds[i], bounds[i + 1], std::ref(chunks[i]));
+        }
+        parse_chunk(bounds[0], bounds[1], chunks[0]);
+        for (std::thread& t : threads)
+        {
+            t.join();
+        }
+    }
+
+    // merge the attribute arrays in file order; corners of a chunk are
+    // offset by the number of attributes in the chunks before it
+    std::vector<glm::vec3> v, vn;
+    std::vector<glm::vec2> vt;
+    std::vector<Corner> corners;
+    for (Chunk& c : chunks)
+    {
+        if (!c.ok)
+        {
+            std::cout << "ERROR: Malformed OBJ file: " << obj_path << "\n";
+            return false;
+        }
+        int base[3]{ static_cast<int>(v.size()), static_cast<int>(vt.size()), static_cast<int>(vn.size()) };
+        v.insert(v.end(), c.v.begin(), c.v.end());
+        vt.insert(vt.end(), c.vt.begin(), c.vt.end());
+        vn.insert(vn.end(), c.vn.begin(), c.vn.end());
+        for (Corner k : c.corners)
+        {
+            if (k.rel & 1) k.v += base[0];
+            if (k.rel & 2) k.t += base[1];
+            if (k.rel & 4) k.n += base[2];
+            corners.push_back(k);
+        }
+    }
+    if (v.empty() || corners.empty())
+    {
+        std::cout << "ERROR: OBJ file has no faces: " << obj_path << "\n";
+        return false;
+    }
+
+    // deduplicate tuples: vertices that share a position are chained from
+    // head[position] so that only those need to be compared
+    std::vector<int> head(v.size(), -1), next;
+    std::vector<Corner> verts;
+    pm.clear();
+    nml.clear();
+    tex.clear();
+    tri.clear();
+    tri.reserve(corners.size());
+    for (Corner const& c : corners)
+    {
+        if (c.v < 0 || c.v >= static_cast<int>(v.size())
+            || c.t >= static_cast<int>(vt.size()) || c.n >= static_cast<int>(vn.size())
+            || (c.rel & 2 && c.t < 0) || (c.rel & 4 && c.n < 0))
+        {
+            std::cout << "ERROR: OBJ face index out of range: " << obj_path << "\n";
+            return false;
+        }
+        int id = head[c.v];
+        while (id >= 0 && (verts[id].t != c.t || verts[id].n != c.n))
+        {
+            id = next[id];
+        }
+        if (id < 0)
+        {
+            id = static_cast<int>(verts.size());
+            verts.push_back(c);
+            next.push_back(head[c.v]);
+            head[c.v] = id;
+        }
+        tri.push_back(static_cast<GLuint>(id));
+    }
+
+    pm.resize(verts.size());
+    nml.resize(verts.size());
+    tex.resize(verts.size());
+    bool has_normals = !vn.empty();
+    for (size_t i = 0; i < verts.size(); ++i)
+    {
+        pm[i] = v[verts[i].v];
+        tex[i] = verts[i].t >= 0 ? vt[verts[i].t] : glm::vec2(0.0f);
+        if (verts[i].n >= 0)
+        {
+            nml[i] = vn[verts[i].n];
+        }
+        else
+        {
+            has_normals = false;
+        }
+    }
+
+    if (!has_normals)
+    {
+        // accumulate per position so that vertices split by their texcoords
+        // still share one smooth normal
+        std::vector<glm::vec3> sum(v.size(), glm::vec3(0.0f));
+        for (size_t i = 0; i < tri.size(); i += 3)
+        {
+            glm::vec3 const& p0 = pm[tri[i]];
+            glm::vec3 n = glm::cross(pm[tri[i + 1]] - p0, pm[tri[i + 2]] - p0);
+            for (size_t k = 0; k < 3; ++k)
+            {
+                sum[verts[tri[i + k]].v] += n;
+            }
+        }
+        for (size_t i = 0; i < verts.size(); ++i)
+        {
+            nml[i] = sum[verts[i].v];
+        }
+    }
+    for (glm::vec3& n : nml)
+    {
+        float len = glm::length(n);
+        n = len > 0.0f ? n / len : glm::vec3(0.0f);
+    }
+
+    glm::vec3 lo = pm[0], hi = pm[0];
+    for (glm::vec3 const& p : pm)
+    {
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+    glm::vec3 center = (lo + hi) * 0.5f;
+    float extent = std::max({ hi.x - lo.x, hi.y - lo.y, hi.z - lo.z }) * 0.5f;
+    float scale = extent > 0.0f ? 1.0f / extent : 1.0f;
+    for (glm::vec3& p : pm)
+    {
+        p = (p - center) * scale;
+    }
+    return true;
+}
+
+/**
+@brief Reorders triangles for the post-transform vertex cache.
+Implements Tom Forsyth's linear-speed vertex cache optimization: triangles
+are emitted greedily, the next one being the triangle with the highest score
+among the triangles of the vertices in a simulated LRU cache (or the first
+triangle not yet emitted when the cache has no candidates).
+
+@param tri The triangle indices to reorder.
+@param vtx_cnt The number of vertices that tri indexes.
+*/
+void GLMesh::optimize_vertex_cache(std::vector<GLuint>& tri, size_t vtx_cnt)
+{
+    size_t tri_cnt = tri.size() / 3;
+    if (tri_cnt == 0)
+    {
+        return;
+    }
+
+    // triangles of vertex v are adj[offset[v], offset[v] + remaining[v]);
+    // emitted triangles are swapped past the end of the list
+    std::vector<GLuint> offset(vtx_cnt + 1, 0), remaining(vtx_cnt, 0), adj(tri.size());
+    for (GLuint v : tri)
+    {
+        ++remaining[v];
+    }
+    for (size_t v = 0; v < vtx_cnt; ++v)
+    {
+        offset[v + 1] = offset[v] + remaining[v];
+    }
+    {
+        std::vector<GLuint> fill(offset.begin(), offset.end() - 1);
+        for (size_t i = 0; i < tri.size(); ++i)
+        {
+            adj[fill[tri[i]]++] = static_cast<GLuint>(i / 3);
+        }
+    }
+
+    std::vector<int> cache_pos(vtx_cnt, -1);
+    std::vector<float> vscore(vtx_cnt), tscore(tri_cnt, 0.0f);
+    for (size_t v = 0; v < vtx_cnt; ++v)
+    {
+        vscore[v] = vertex_score(-1, remaining[v]);
+    }
+    for (size_t i = 0; i < tri.size(); ++i)
+    {
+        tscore[i / 3] += vscore[tri[i]];
+    }
+    std::vector<unsigned char> emitted(tri_cnt, 0);
+
+    std::vector<GLuint> out, cache, next_cache;
+    out.reserve(tri.size());
+    cache.reserve(vcache_size + 3);
+    next_cache.reserve(vcache_size + 3);
+    size_t cursor = 0;
+    size_t best = static_cast<size_t>(std::max_element(tscore.begin(), tscore.end()) - tscore.begin());
+    for (;;)
+    {
+        emitted[best] = 1;
+        GLuint const* t = &tri[best * 3];
+        out.insert(out.end(), t, t + 3);
+        if (out.size() == tri.size())
+        {
+            break;
+        }
+
+        // the emitted triangle's vertices move to the front of the cache
+        next_cache.assign(t, t + 3);
+        for (GLuint v : cache)
+        {
+            if (v != t[0] && v != t[1] && v != t[2])
+            {
+                next_cache.push_back(v);
+            }
+        }
+        for (int k = 0; k < 3; ++k)
+        {
+            GLuint v = t[k];
+            GLuint* list = &adj[offset[v]];
+            GLuint* it = std::find(list, list + remaining[v], static_cast<GLuint>(best));
+            std::swap(*it, list[--remaining[v]]);
+        }
+        // rescore every vertex whose cache position or valence changed and
+        // pass the change on to its remaining triangles
+        for (size_t i = 0; i < next_cache.size(); ++i)
+        {
+            GLuint v = next_cache[i];
+            cache_pos[v] = i < vcache_size ? static_cast<int>(i) : -1;
+            float score = vertex_score(cache_pos[v], remaining[v]);
+            float delta = score - vscore[v];
+            vscore[v] = score;
+            for (GLuint j = offset[v]; j < offset[v] + remaining[v]; ++j)
+            {
+                tscore[adj[j]] += delta;
+            }
+        }
+        if (next_cache.size() > vcache_size)
+        {
+            next_cache.resize(vcache_size);
+        }
+        cache.swap(next_cache);
+
+        float best_score = -1.0f;
+        best = tri_cnt;
+        for (GLuint v : cache)
+        {
+            for (GLuint j = offset[v]; j < offset[v] + remaining[v]; ++j)
+            {
+                if (tscore[adj[j]] > best_score)
+                {
+                    best_score = tscore[adj[j]];
+                    best = adj[j];
+                }
+            }
+        }
+        if (best == tri_cnt)
+        {
+            while (emitted[cursor])
+            {
+                ++cursor;
+            }
+            best = cursor;
+        }
+    }
+    tri.swap(out);
+}
+
+/**
+@brief Renumbers vertices in the order that the triangles first use them.
+After optimize_vertex_cache(), this makes the vertex fetches of consecutive
+triangles touch neighboring memory. Vertices that no triangle uses are
+dropped.
+
+@param pm, nml, tex The vertex arrays to reorder.
+@param tri The triangle indices to renumber.
+*/
+void GLMesh::optimize_vertex_fetch(std::vector<glm::vec3>& pm, std::vector<glm::vec3>& nml,
+    std::vector<glm::vec2>& tex, std::vector<GLuint>& tri)
+{
+    constexpr GLuint unused = ~0u;
+    std::vector<GLuint> remap(pm.size(), unused);
+    std::vector<glm::vec3> new_pm, new_nml;
+    std::vector<glm::vec2> new_tex;
+    new_pm.reserve(pm.size());
+    new_nml.reserve(pm.size());
+    new_tex.reserve(pm.size());
+    for (GLuint& v : tri)
+    {
+        if (remap[v] == unused)
+        {
+            remap[v] = static_cast<GLuint>(new_pm.size());
+            new_pm.push_back(pm[v]);
+            new_nml.push_back(nml[v]);
+            new_tex.push_back(tex[v]);
+        }
+        v = remap[v];
+    }
+    pm.swap(new_pm);
+    nml.swap(new_nml);
+    tex.swap(new_tex);
+}
+
+/**
+@brief Returns the path of the binary cache of an OBJ file.
+
+@param obj_path The path of the OBJ file.
+@return obj_path with its extension replaced by .bmsh.
+*/
+std::string GLMesh::cache_path(std::string const& obj_path)
+{
+    return std::filesystem::path(obj_path).replace_extension(".bmsh").string();
+}
+
+/**
+@brief Loads an OBJ mesh, preferring its binary cache.
+
+@param obj_path The path of the OBJ file.
+@param pm Receives the vertex positions.
+@param nml Receives the vertex normals.
+@param tex Receives the vertex texture coordinates.
+@param tri Receives the triangle indices.
+@return True if the mesh was loaded from the cache or the OBJ file; false
+if the OBJ file cannot be parsed.
+*/
+bool GLMesh::load(std::string const& obj_path,
+    std::vector<glm::vec3>& pm, std::vector<glm::vec3>& nml,
+    std::vector<glm::vec2>& tex, std::vector<GLuint>& tri)
+{
+    std::error_code ec;
+    std::uint64_t obj_size = std::filesystem::file_size(obj_path, ec);
+    if (ec)
+    {
+        return false;
+    }
+    std::int64_t obj_time = static_cast<std::int64_t>(
+        std::filesystem::last_write_time(obj_path, ec).time_since_epoch().count());
+
+    std::string cache = cache_path(obj_path);
+    if (read_cache(cache, obj_size, obj_time, pm, nml, tex, tri))
+    {
+        return true;
+    }
+
+    if (!parse_obj(obj_path, pm, nml, tex, tri))
+    {
+        return false;
+    }
+    optimize_vertex_cache(tri, pm.size());
+    optimize_vertex_fetch(pm, nml, tex, tri);
+    if (!write_cache(cache, obj_size, obj_time, pm, nml, tex, tri))
+    {
+        std::cout << "WARNING: Unable to write mesh cache: " << cache << "\n";
+    }
+    return true;
+}
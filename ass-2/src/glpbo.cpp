@@ -12,23 +12,19 @@ to OpenGL implementations.
 
 *//*__________________________________________________________________________*/
 #include <glpbo.h>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <cstdint>
+#include <iterator>
+#include <immintrin.h> // SSE2 / AVX2 intrinsics used by the vertex stage and rasterizer core
 #define UNREFERENCED_PARAMETER(P) (P)  
 #define int_only static_cast<int>
 
 namespace CORE10
 {
-    std::vector<std::string> objectName{ "ogre","cube" };
-    std::string textureName{ "ogre" };
-
-    glm::vec3 cam_pos = glm::vec3(0.f, 0.f, 10.f);
-    glm::vec3 target = glm::vec3(0.f, 0.f, 0.f);
-
-    float near_plane = 8.f;
-    float far_plane = 12.f;
-    float top_plane = 1.5f;
-    float bottom_plane = -1.5f;
-    float left_plane;
-    float right_plane;
+    std::string sceneName{ "ass-2" };
 
     glm::dvec3 intensity{1.0,1.0,1.0}; // we choose to not store the alpha component
     glm::dvec3 light_pos{ 0.0,0.0,10.0 };
@@ -43,20 +39,75 @@ GLsizei GLPbo::height;
 GLPbo::Color* GLPbo::ptr_to_pbo{ nullptr };
 GLuint GLPbo::vaoid;
 GLuint GLPbo::elem_cnt;
-GLuint GLPbo::pboid;
+std::vector<GLPbo::PboSlot> GLPbo::pbo_ring;
+GLuint GLPbo::pbo_idx;
+double GLPbo::pbo_wait_ms;
+bool GLPbo::is_headless{ false };
+std::vector<GLPbo::Color> GLPbo::host_fb;
 GLuint GLPbo::texid;
 GLSLShader GLPbo::shdr_pgm;
 GLPbo::Color GLPbo::clear_clr;
-glm::mat4 view_chain;
-double* depthBuffer;
+GLint GLPbo::tiles_x;
+GLint GLPbo::tiles_y;
+std::vector<GLPbo::Tile> GLPbo::tiles;
+std::vector<GLPbo::ClippedTri> GLPbo::clipped_tris;
+GLPbo::CullStats GLPbo::cull_stats;
+std::vector<GLPbo::TriRef> GLPbo::visible_tris;
+std::vector<GLPbo::Instance> GLPbo::instances;
+GLuint GLPbo::current_instance{};
+// the perspective camera's field of view frames the same height at target as
+// the orthographic view volume
+GLPbo::Camera GLPbo::camera{
+    GLPbo::Camera::Projection::orthographic,
+    glm::vec3(0.f, 0.f, 10.f), glm::vec3(0.f, 0.f, 0.f), glm::vec3(0.f, 1.f, 0.f),
+    8.f, 12.f,   // near and far planes
+    1.5f, -1.5f, // top and bottom planes
+    17.06f,      // 2 * atan(1.5 / 10) in degrees
+};
+glm::mat4 view_chain; // viewport * projection * view, built by set_camera()
+float* depthBuffer; // depth in [0, 1] - single precision halves the bandwidth
+// Hierarchical Z buffer: the depth range of every hiZBlockSize x hiZBlockSize
+// block of the depth buffer. A triangle whose nearest depth is not in front
+// of a block's farthest depth cannot pass the depth test anywhere in the
+// block, so the block is rejected without per-pixel tests. Blocks are marked
+// dirty when written and their range is recomputed when next tested.
+// Every block also tracks clears of the color and depth buffers. Clearing
+// only resets these flags; a block's pixels are cleared when a triangle
+// first reaches the block, or when its tile is resolved at the end of the
+// frame, and only if the block was painted since it was last cleared.
+constexpr GLint hiZBlockSize = 8;
+struct HiZBlock {
+    float zmin, zmax;
+    bool dirty;
+    bool depth_valid;   // depth values were cleared this frame
+    bool painted;       // color block may hold pixels other than clear_clr
+    bool color_pending; // color block must be cleared before use
+};
+std::vector<HiZBlock> hiZBuffer;
+GLint hiZBlocksX{};
+std::atomic<unsigned long long> hiZRejected{}; // fragments rejected by Hi-Z this frame
+// class of each triangle, written by the first pass of cull_triangles()
+enum TriClass : unsigned char { tri_visible, tri_backfaced, tri_zero_area, tri_offscreen };
+std::vector<unsigned char> triClass;
+// Jobs of the culling stage. Every job classifies up to cullJobClusters
+// clusters of one instance; the visible counts are scanned into offsets.
+struct CullJob {
+    GLuint inst;                // index into GLPbo::instances
+    GLuint first, last;         // clusters [first, last) of the instance's model
+    size_t class_base;          // index in triClass of the job's first triangle
+    GLuint count[4];            // triangles of each TriClass
+    GLuint clusters;            // clusters culled
+    GLuint offset;              // first index in visible_tris written by the job
+};
+std::vector<CullJob> cullJobs;
+constexpr size_t cullJobClusters = 32; // clusters classified by one job
 GLPbo::Model ModelTrans{};
 GLPbo::Model GLPbo::mdl;
-std::unordered_map<std::string, GLPbo::Model> mdl_map;
-std::unordered_map<std::string, GLPbo::Model>::iterator current_mdl_iterator;
+std::unordered_map<std::string, GLPbo::Model> mdl_map; // models by name, shared by their instances
 bool light_rot = false;
 GLuint tex_hdl{};
-GLuint textureWidth{}, textureHeight{}, bytes_per_texel{};
-std::vector<glm::vec3>textureArray{};
+std::unordered_map<std::string, GLTexture> textureMap; // textures by name, loaded by setup_texobj()
+GLTexture const blankTexture; // instances without a texture sample white
 bool xrotate = false;
 bool yrotate = false;
 bool previous_keystateM = false;
@@ -65,15 +116,15 @@ float  angle{};
 float radians{};
 float light_rad{};
 float light_angle{ 0.f };
-bool  cull = true;
 std::string mode{};
 //glm::mat3 m_rotation{};
-int cull_counter{};
 int vtx_counter{};
 int tri_counter{};
 float timesSpeed = 1.0f;
 
 float normalizeDegrees(float degrees);
+bool clip_line(glm::dvec2& p0, glm::dvec2& p1);
+void write_png(std::ostream& os, std::vector<unsigned char> const& rgb, GLsizei w, GLsizei h);
 bool zAxisRotate = false;
 bool xAxisRotate = false;
 
@@ -87,9 +138,17 @@ The resulting color values are mapped to the range [0, 255] and assigned to the
 The PBO is then mapped to the application side using glMapNamedBuffer, and the clear_color_buffer function is called to fill the PBO with the new color.
 Finally, the PBO is unmapepd and the texture image is updated using glTextureSubImage2D.
 
-\note This function assumes that the necessary variables and objects (timesSpeed, clear_clr, pboid, ptr_to_pbo, texid, width, and height) have been properly initialized.
+The PBOs form a ring: every frame waits on the fence of the next PBO in the ring, which is only signalled once the GPU
+has finished copying the image written into it a ring's length ago, then renders into its persistent mapping and
+issues the copy to the texture followed by a new fence. The time spent waiting is stored in pbo_wait_ms.
+
+Every call opens a new frame of GLProfiler, and the stages of the pipeline are timed into it.
+
+\note This function assumes that the necessary variables and objects (timesSpeed, clear_clr, pbo_ring, ptr_to_pbo, texid, width, and height) have been properly initialized.
 *************************************************************************/
 void GLPbo::emulate() {
+    GLProfiler::begin_frame();
+    GLProfiler::Scope frame_timer{ GLProfiler::emulate };
 
     if (GLHelper::keystateZ)
     {
@@ -104,41 +163,44 @@ void GLPbo::emulate() {
 
     if (GLHelper::keystateM)
     {
-        // The 'M' key has just been released.
-        ++current_mdl_iterator;
-        if (current_mdl_iterator == mdl_map.end())
+        // The 'M' key has just been released - select the next instance.
+        if (!instances.empty())
         {
-            current_mdl_iterator = mdl_map.begin();
+            current_instance = (current_instance + 1) % static_cast<GLuint>(instances.size());
         }
-        current_mdl_iterator->second.rotating = false;
-        cull = true;
-        cull_counter = 0;
         GLHelper::keystateM = GL_FALSE;
     }
 
-    GLPbo::Model& current_mdl = current_mdl_iterator->second;
-
     if (GLHelper::keystateW)
     {
-        current_mdl.Tasking = static_cast<GLPbo::Model::task>(static_cast<int>(current_mdl.Tasking) + 1);
-        if (static_cast<int>(current_mdl.Tasking) == 7)
+        if (!instances.empty())
         {
-            current_mdl.Tasking = GLPbo::Model::task::wireframe;
+            Instance& current = instances[current_instance];
+            current.Tasking = static_cast<GLPbo::Model::task>(static_cast<int>(current.Tasking) + 1);
+            if (static_cast<int>(current.Tasking) == 7)
+            {
+                current.Tasking = GLPbo::Model::task::wireframe;
+            }
         }
         GLHelper::keystateW = GL_FALSE;
     }
 
     if (GLHelper::keystateR)
     {
-        current_mdl_iterator->second.rotating = !current_mdl_iterator->second.rotating;
+        if (!instances.empty())
+        {
+            instances[current_instance].rotating = !instances[current_instance].rotating;
+        }
         GLHelper::keystateR = GL_FALSE;
      
     }
 
-    if (current_mdl_iterator->second.rotating)
+    for (Instance& inst : instances)
     {
-        
-        current_mdl_iterator->second.angle = normalizeDegrees(current_mdl_iterator->second.angle + 1);
+        if (inst.rotating)
+        {
+            inst.angle = normalizeDegrees(inst.angle + inst.spin);
+        }
     }
 
     if (GLHelper::keystateL)
@@ -147,6 +209,30 @@ void GLPbo::emulate() {
         GLHelper::keystateL = GL_FALSE;
     }
 
+    if (GLHelper::keystateT)
+    {
+        // export the timings of the frames in the profiler's ring
+        if (GLProfiler::write_csv("ass-2-profile.csv") && GLProfiler::write_json("ass-2-profile.json"))
+        {
+            std::cout << "Wrote " << GLProfiler::frames() << " frames to ass-2-profile.csv and ass-2-profile.json\n";
+        }
+        else
+        {
+            std::cout << "ERROR: Unable to write profile files\n";
+        }
+        GLHelper::keystateT = GL_FALSE;
+    }
+
+    if (GLHelper::keystateP)
+    {
+        // switch between the orthographic and perspective projections
+        Camera cam = camera;
+        cam.projection = cam.projection == Camera::Projection::perspective
+            ? Camera::Projection::orthographic : Camera::Projection::perspective;
+        set_camera(cam);
+        GLHelper::keystateP = GL_FALSE;
+    }
+
     if (light_rot)
     {
         glm::vec3 y_axis = { 0,1,0 };
@@ -168,84 +254,131 @@ void GLPbo::emulate() {
         GLHelper::keystateX = GL_FALSE;
     }
 
-    // Mapping pboid to client address ptr_to_pbo
-    ptr_to_pbo = static_cast<GLPbo::Color*>(glMapNamedBuffer(pboid, GL_WRITE_ONLY));
-    clear_color_buffer();
-    clear_depth_buffer();
-    viewport_xform(current_mdl);
+    // wait until the GPU has stopped reading the PBO we are about to write
+    PboSlot& slot = pbo_ring[pbo_idx];
+    auto wait_start = std::chrono::steady_clock::now();
+    if (slot.fence)
+    {
+        while (glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+        {
+        }
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+    }
+    auto wait_time = std::chrono::steady_clock::now() - wait_start;
+    pbo_wait_ms = std::chrono::duration<double, std::milli>(wait_time).count();
+    GLProfiler::add(GLProfiler::pbo_wait, wait_time);
+
+    // the PBO is persistently mapped and keeps its contents between frames,
+    // so both clears are deferred to the blocks that were painted (in this
+    // PBO) or are about to be painted
+    ptr_to_pbo = slot.ptr;
+    {
+        GLProfiler::Scope timer{ GLProfiler::clear };
+        for (size_t i = 0; i < hiZBuffer.size(); ++i)
+        {
+            hiZBuffer[i].painted = slot.painted[i] != 0;
+        }
+        clear_color_buffer();
+        clear_depth_buffer();
+    }
+    hiZRejected = 0;
+    {
+        GLProfiler::Scope timer{ GLProfiler::vertex };
+        viewport_xform();
+    }
+    {
+        GLProfiler::Scope timer{ GLProfiler::cull };
+        cull_triangles();
+    }
+    {
+        GLProfiler::Scope timer{ GLProfiler::lighting };
+        setup_lighting();
+    }
+
+    mode.clear();
+    if (!instances.empty())
+    {
+        switch (instances[current_instance].Tasking)
+        {
+        case GLPbo::Model::task::wireframe:     mode = "Wireframe"; break;
+        case GLPbo::Model::task::depth:         mode = "Depth Buffer"; break;
+        case GLPbo::Model::task::faceted:       mode = "Faceted"; break;
+        case GLPbo::Model::task::shaded:        mode = "Shaded"; break;
+        case GLPbo::Model::task::textured:      mode = "Textured"; break;
+        case GLPbo::Model::task::faceted_tex:   mode = "Textured/Faceted"; break;
+        case GLPbo::Model::task::smooth_tex:    mode = "Textured/Shaded"; break;
+        }
+    }
 
-    for (size_t i = 0; i < current_mdl.tri.size(); i += 3)
+    // sort triangles into screen tiles and let the worker threads
+    // rasterize the tiles in parallel - each tile has a single owner
+    {
+        GLProfiler::Scope timer{ GLProfiler::bin };
+        bin_triangles();
+    }
     {
-        // Get the indices of the three vertices that form the triangle.
-        int idx1 = current_mdl.tri[i];
-        int idx2 = current_mdl.tri[i + 1];
-        int idx3 = current_mdl.tri[i + 2];
+        GLProfiler::Scope timer{ GLProfiler::raster };
+        GLThreadPool::parallel_for(static_cast<GLuint>(tiles.size()),
+            [](GLuint index, GLuint) { rasterize_tile(tiles[index]); });
+    }
 
-        // Calculate two edges of the triangle.
-        glm::vec3 edge1 = current_mdl.pd[idx2] - current_mdl.pd[idx1];
-        glm::vec3 edge2 = current_mdl.pd[idx3] - current_mdl.pd[idx1];
+    // lines are cheap and may leave the screen, so they are not binned and
+    // are drawn over the rasterized instances by the main thread ...
+    {
+        GLProfiler::Scope timer{ GLProfiler::raster_wireframe };
+        for (TriRef const& ref : visible_tris)
+        {
+            Instance const& inst = instances[ref.inst];
+            if (inst.Tasking != GLPbo::Model::task::wireframe)
+            {
+                continue;
+            }
+            // Get the indices of the three vertices that form the triangle.
+            int idx1 = inst.model->tri[ref.tri];
+            int idx2 = inst.model->tri[ref.tri + 1];
+            int idx3 = inst.model->tri[ref.tri + 2];
+            if (!(inst.pw[idx1] > 0.0f && inst.pw[idx2] > 0.0f && inst.pw[idx3] > 0.0f))
+            {
+                continue; // a vertex is behind the eye
+            }
 
-        // Calculate the normal of the triangle.
-        glm::vec3 normal = glm::cross(edge1, edge2);
-        // Check if the triangle is back-facing.
-        if (normal.z >= 0) {
-            switch (current_mdl.Tasking)
+            int const edges[3][2] = { { idx1, idx2 }, { idx2, idx3 }, { idx3, idx1 } };
+            for (auto const& edge : edges)
             {
-            case GLPbo::Model::task::wireframe:
-                render_linebresenham(int_only(current_mdl.pd[idx1].x), int_only(current_mdl.pd[idx1].y), int_only(current_mdl.pd[idx2].x), int_only(current_mdl.pd[idx2].y), { 0, 0, 255 ,255 });
-                render_linebresenham(int_only(current_mdl.pd[idx2].x), int_only(current_mdl.pd[idx2].y), int_only(current_mdl.pd[idx3].x), int_only(current_mdl.pd[idx3].y), { 0, 0, 255 ,255 });
-                render_linebresenham(int_only(current_mdl.pd[idx3].x), int_only(current_mdl.pd[idx3].y), int_only(current_mdl.pd[idx1].x), int_only(current_mdl.pd[idx1].y), { 0, 0, 255 ,255 });
-                mode = "Wireframe";
-                break;
-            case GLPbo::Model::task::depth:
-                render_shadow_map(current_mdl.pd[idx1], current_mdl.pd[idx2], current_mdl.pd[idx3]);
-                mode = "Depth Buffer";
-                break;
-            case GLPbo::Model::task::faceted:
-                render_faceted_shading(current_mdl.pd[idx1], current_mdl.pd[idx2], current_mdl.pd[idx3], current_mdl.pm[idx1], current_mdl.pm[idx2], current_mdl.pm[idx3]);
-                mode = "Faceted";
-                break;
-            case GLPbo::Model::task::shaded:
-                render_smooth_shading(current_mdl.pd[idx1], current_mdl.pd[idx2], current_mdl.pd[idx3],
-                    current_mdl.pm[idx1], current_mdl.pm[idx2], current_mdl.pm[idx3],
-                    current_mdl.nml[idx1], current_mdl.nml[idx2], current_mdl.nml[idx3]);
-                mode = "Shaded";
-                break;
-
-            case GLPbo::Model::task::textured:
-                render_texture_map(current_mdl.pd[idx1], current_mdl.pd[idx2], current_mdl.pd[idx3],
-                    current_mdl.tex[idx1], current_mdl.tex[idx2], current_mdl.tex[idx3]);
-                mode = "Textured";
-                break;
-            case GLPbo::Model::task::faceted_tex:
-                render_faceted_texture(current_mdl.pd[idx1], current_mdl.pd[idx2], current_mdl.pd[idx3], current_mdl.pm[idx1], current_mdl.pm[idx2], current_mdl.pm[idx3], current_mdl.tex[idx1], current_mdl.tex[idx2], current_mdl.tex[idx3]);
-                mode = "Textured/Faceted";
-                break;
-            case GLPbo::Model::task::smooth_tex:
-                render_smooth_texture(current_mdl.pd[idx1], current_mdl.pd[idx2], current_mdl.pd[idx3], 
-                    current_mdl.pm[idx1], current_mdl.pm[idx2], current_mdl.pm[idx3], 
-                    current_mdl.nml[idx1], current_mdl.nml[idx2], current_mdl.nml[idx3], 
-                    current_mdl.tex[idx1], current_mdl.tex[idx2], current_mdl.tex[idx3]);
-                mode = "Textured/Shaded";
-                break;
+                glm::dvec2 p0(inst.pd[edge[0]]), p1(inst.pd[edge[1]]);
+                if (clip_line(p0, p1))
+                {
+                    render_linebresenham(int_only(p0.x), int_only(p0.y), int_only(p1.x), int_only(p1.y), { 0, 0, 255 ,255 });
+                }
             }
         }
-        
-        else if (cull)
-        {
-            cull_counter++;
-        }
     }
-    cull = false;
+    for (size_t i = 0; i < hiZBuffer.size(); ++i)
+    {
+        slot.painted[i] = hiZBuffer[i].painted;
+    }
+    if (is_headless)
+    {
+        // the frame stays in host_fb until save_frame() is called
+        return;
+    }
     // BIND A NAMED BUFFER OBJECT
     // GL_PIXEL_UNPACK_BUFFER - "target" - purpose is for Texture data source
-    // pboid - "buffer" - name of the sourced buffer object
-    glUnmapNamedBuffer(pboid);
-    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pboid);
+    // slot.id - "buffer" - name of the sourced buffer object
+    // The mapping is coherent, so the writes above are visible to the copy
+    // without unmapping the PBO
+    GLProfiler::Scope upload_timer{ GLProfiler::upload };
+    GLProfiler::gpu_begin(GLProfiler::gpu_upload);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.id);
     // Associate the PBO with the texture image - texid read (unpack) their data from the buffer object into texid image store 
     glTextureSubImage2D(texid, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
     // Unbind the PBO
     glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    GLProfiler::gpu_end(GLProfiler::gpu_upload);
+    // signalled once the copy above has completed
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    pbo_idx = (pbo_idx + 1) % static_cast<GLuint>(pbo_ring.size());
 }
 
 /*!***********************************************************************
@@ -262,6 +395,7 @@ Finally, the shader program is un-used with shdr_pgm.UnUse().
 
 *************************************************************************/
 void GLPbo::draw_fullwindow_quad() {
+    GLProfiler::Scope timer{ GLProfiler::present };
     std::stringstream sstr;
     // Bind texture unit
     glBindTextureUnit(0, texid);
@@ -277,14 +411,313 @@ void GLPbo::draw_fullwindow_quad() {
     glBindVertexArray(vaoid);
 
     // draw
+    GLProfiler::gpu_begin(GLProfiler::gpu_quad);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, elem_cnt);
+    GLProfiler::gpu_end(GLProfiler::gpu_quad);
     shdr_pgm.UnUse();
-    std::string modelName = current_mdl_iterator->first;
+    size_t scene_tris = 0, scene_clusters = 0;
+    for (Instance const& inst : instances)
+    {
+        scene_tris += inst.model->tri.size() / 3;
+        scene_clusters += inst.model->clusters.size();
+    }
+    std::string modelName = instances.empty() ? std::string("none") : instances[current_instance].name;
+    GLProfiler::Stats frame_stats = GLProfiler::stats(GLProfiler::frame);
 
-    sstr << std::fixed << std::setprecision(2) << "A2 | Benjamin Lee | Model: " << modelName << " | Mode: " << mode << " | Vertices: " << current_mdl_iterator->second.pm.size() << " | Triangles: " << current_mdl_iterator->second.tri.size() / 3 << " | Culled: " << cull_counter << " | FPS: " << GLHelper::fps;
+    sstr << std::fixed << std::setprecision(2) << "A2 | Benjamin Lee | Instances: " << instances.size() << " | Selected: " << modelName << " | Mode: " << mode << " | Projection: " << (camera.projection == Camera::Projection::perspective ? "Perspective" : "Orthographic") << " | Triangles: " << scene_tris << " | Visible: " << cull_stats.visible << " | Backfaced: " << cull_stats.backfaced << " | Zero-area: " << cull_stats.zero_area << " | Off-screen: " << cull_stats.offscreen << " | Clusters culled: " << cull_stats.clusters << "/" << scene_clusters << " | Instances culled: " << cull_stats.instances << " | Hi-Z rejected: " << hiZRejected << " | PBO wait: " << pbo_wait_ms << " ms | Frame: " << frame_stats.avg << " ms (p99 " << frame_stats.p99 << ") | FPS: " << GLHelper::fps;
     glfwSetWindowTitle(GLHelper::ptr_window, sstr.str().c_str());
 }
 
+/*!***********************************************************************
+\brief Writes the most recent frame to an image file.
+
+\param pathname The file to write. A name ending in ".png" is written as an 8-bit RGB PNG, any other name as a
+binary (P6) PPM.
+
+\details In headless mode the frame is read from host_fb; otherwise it is read back from the texture object that the
+last frame was copied to, which waits for that copy to complete. Rows are written from the top of the window down.
+
+\return True if the file was written; false otherwise.
+
+*************************************************************************/
+bool GLPbo::save_frame(std::string const& pathname) {
+    std::vector<Color> readback;
+    Color const* pixels = host_fb.data();
+    if (!is_headless)
+    {
+        readback.resize(pixel_cnt);
+        glGetTextureImage(texid, 0, GL_RGBA, GL_UNSIGNED_BYTE, byte_cnt, readback.data());
+        pixels = readback.data();
+    }
+
+    // RGB rows, top row first
+    std::vector<unsigned char> rgb(static_cast<size_t>(pixel_cnt) * 3);
+    for (GLsizei y = 0; y < height; ++y)
+    {
+        Color const* src = pixels + static_cast<size_t>(height - 1 - y) * width;
+        unsigned char* dst = rgb.data() + static_cast<size_t>(y) * width * 3;
+        for (GLsizei x = 0; x < width; ++x)
+        {
+            dst[3 * x + 0] = src[x].rgba.r;
+            dst[3 * x + 1] = src[x].rgba.g;
+            dst[3 * x + 2] = src[x].rgba.b;
+        }
+    }
+
+    std::ofstream ofs{ pathname, std::ios::binary };
+    if (!ofs)
+    {
+        std::cout << "ERROR: Unable to open image file: " << pathname << "\n";
+        return false;
+    }
+    bool png = pathname.size() >= 4 && pathname.compare(pathname.size() - 4, 4, ".png") == 0;
+    if (png)
+    {
+        write_png(ofs, rgb, width, height);
+    }
+    else
+    {
+        ofs << "P6\n" << width << " " << height << "\n255\n";
+        ofs.write(reinterpret_cast<char const*>(rgb.data()), rgb.size());
+    }
+    return static_cast<bool>(ofs);
+}
+
+/*!***********************************************************************
+\brief Sets the shading mode of every instance in the scene.
+
+\param task The shading mode to use.
+
+\details Interactive builds cycle through the modes of the selected instance with the W key; this lets headless runs
+pick a mode for the whole scene directly.
+
+*************************************************************************/
+void GLPbo::set_render_mode(Model::task task) {
+    for (Instance& inst : instances)
+    {
+        inst.Tasking = task;
+    }
+}
+
+/**
+@brief Replaces the camera and rebuilds the view chain.
+The view chain maps world coordinates to clip coordinates with the viewport
+transform already applied, so that dividing by clip w gives window
+coordinates. The left and right planes of either projection follow from the
+aspect ratio of the window.
+
+@param cam The new camera.
+*/
+void GLPbo::set_camera(Camera const& cam)
+{
+    camera = cam;
+
+    glm::mat4 view_port{
+    width * 0.5, 0                   , 0, 0,
+    0                  , height * 0.5, 0, 0,
+    0                  , 0                   , 1, 0,
+     width * 0.5, height * 0.5, 0, 1
+    };
+
+    glm::mat4 view = glm::lookAt(cam.eye, cam.target, cam.up);
+
+    float aspect_ratio = (float)GLPbo::width / (float)GLPbo::height;
+    glm::mat4 projection = cam.projection == Camera::Projection::perspective
+        ? glm::perspective(glm::radians(cam.fovy), aspect_ratio, cam.near_plane, cam.far_plane)
+        : glm::ortho(aspect_ratio * cam.bottom, aspect_ratio * cam.top, cam.bottom, cam.top, cam.near_plane, cam.far_plane);
+
+    view_chain = view_port * projection * view;
+}
+
+/*!***********************************************************************
+\brief Replaces the scene by the instances of a scene file.
+
+\param name The name of the scene; the file is ../scenes/<name>.scn.
+
+\details A scene file extends the list of model names of ass-1.scn: every line names a model, optionally followed
+by the shading mode, texture, position, scale, angle and spin of the instance:
+
+    <model> [<mode> [<texture> [<x> <y> <z> [<scale> [<angle> [<spin>]]]]]]
+
+The mode is one of wireframe, depth, faceted, shaded, textured, faceted_tex and smooth_tex; the texture is the name
+of an image in ../images, or none. A line
+
+    grid <nx> <ny> <nz> <dx> <dy> <dz>
+
+replaces the instance on the previous line by nx * ny * nz copies offset by multiples of (dx, dy, dz), which makes
+scenes of thousands of instances easy to write. The counts are whole numbers of at least 1 whose product is at most
+max_grid_instances. A line
+
+    texture <texture> <wrap> <filter>
+
+selects the sampler state of a texture: the wrap mode is clamp or repeat, the filter is nearest, bilinear or
+trilinear. Textures are loaded with clamp and trilinear and keep the state last selected for them. Everything after
+a '#' is a comment.
+Models and textures are loaded the first time a scene names them and are shared by all of their instances.
+
+\return True if the scene was loaded; on failure an error is printed and the current scene is kept.
+
+*************************************************************************/
+bool GLPbo::load_scene(std::string const& name) {
+    static char const* const mode_names[] = {
+        "wireframe", "depth", "faceted", "shaded", "textured", "faceted_tex", "smooth_tex",
+    };
+    static char const* const wrap_names[] = { "clamp", "repeat" };
+    static char const* const filter_names[] = { "nearest", "bilinear", "trilinear" };
+    // most copies a single grid line may make
+    constexpr size_t max_grid_instances = size_t{ 1 } << 20;
+
+    std::string file = "../scenes/" + name + ".scn";
+    std::ifstream ifs{ file };
+    if (!ifs) {
+        std::cout << "ERROR: Unable to open scene file: "
+            << name << "\n";
+        return false;
+    }
+
+    std::vector<Instance> scene;
+    // sampler states given by texture lines - applied once the whole scene
+    // has loaded, so that a failed load changes no texture
+    struct Sampler {
+        std::string texture;
+        GLTexture::Wrap wrap;
+        GLTexture::Filter filter;
+    };
+    std::vector<Sampler> samplers;
+    std::string line;
+    for (int line_no = 1; std::getline(ifs, line); ++line_no)
+    {
+        std::istringstream iss{ line.substr(0, line.find('#')) };
+        std::vector<std::string> tok{ std::istream_iterator<std::string>(iss), std::istream_iterator<std::string>() };
+        if (tok.empty())
+        {
+            continue;
+        }
+        // parses tok[i] into value (a float or an integer) and reports
+        // whether all of it was a number of that type
+        auto number = [&tok](size_t i, auto& value)
+        {
+            char const* first = tok[i].data();
+            char const* last = first + tok[i].size();
+            auto [ptr, ec] = std::from_chars(first, last, value);
+            return ec == std::errc() && ptr == last;
+        };
+        bool ok = true;
+
+        if (tok[0] == "grid")
+        {
+            size_t n[3]{};
+            float d[3]{};
+            size_t copies = 1;
+            ok = !scene.empty() && tok.size() == 7;
+            for (size_t i = 0; ok && i < 3; ++i)
+            {
+                // comparing with max_grid_instances / copies keeps the
+                // product from overflowing
+                ok = number(1 + i, n[i]) && number(4 + i, d[i])
+                    && n[i] >= 1 && n[i] <= max_grid_instances / copies;
+                copies *= ok ? n[i] : 1;
+            }
+            if (ok)
+            {
+                Instance base = scene.back();
+                scene.pop_back();
+                scene.reserve(scene.size() + copies);
+                for (size_t k = 0; k < n[2]; ++k)
+                {
+                    for (size_t j = 0; j < n[1]; ++j)
+                    {
+                        for (size_t i = 0; i < n[0]; ++i)
+                        {
+                            scene.push_back(base);
+                            scene.back().position += glm::vec3(i * d[0], j * d[1], k * d[2]);
+                        }
+                    }
+                }
+                continue;
+            }
+        }
+        else if (tok[0] == "texture")
+        {
+            ok = tok.size() == 4;
+            auto wrap = ok ? std::find(std::begin(wrap_names), std::end(wrap_names), tok[2]) : std::end(wrap_names);
+            auto filter = ok ? std::find(std::begin(filter_names), std::end(filter_names), tok[3]) : std::end(filter_names);
+            if (wrap != std::end(wrap_names) && filter != std::end(filter_names))
+            {
+                if (!setup_texobj(tok[1]))
+                {
+                    std::cout << "ERROR: Unable to read texture file: " << tok[1]
+                        << " on line " << line_no << " in scene file: " << name << "\n";
+                    return false;
+                }
+                samplers.push_back({ tok[1], static_cast<GLTexture::Wrap>(wrap - std::begin(wrap_names)),
+                    static_cast<GLTexture::Filter>(filter - std::begin(filter_names)) });
+                continue;
+            }
+        }
+        else if (tok.size() <= 9 && tok.size() != 4 && tok.size() != 5)
+        {
+            Instance inst;
+            inst.name = tok[0];
+            if (tok.size() > 1)
+            {
+                auto it = std::find(std::begin(mode_names), std::end(mode_names), tok[1]);
+                ok = it != std::end(mode_names);
+                inst.Tasking = static_cast<Model::task>(it - std::begin(mode_names));
+            }
+            float* values[] = { &inst.position.x, &inst.position.y, &inst.position.z, &inst.scale, &inst.angle, &inst.spin };
+            for (size_t i = 3; ok && i < tok.size(); ++i)
+            {
+                ok = number(i, *values[i - 3]);
+            }
+            // instances only start rotating if the scene gives their spin
+            inst.rotating = tok.size() == 9 && inst.spin != 0.0f;
+
+            if (ok && mdl_map.find(inst.name) == mdl_map.end())
+            {
+                GLPbo::mdl = Model{};
+                if (!GLMesh::load("../meshes/" + inst.name + ".obj", mdl.pm, mdl.nml, mdl.tex, mdl.tri))
+                {
+                    std::cout << "ERROR: Unable to load model: "
+                        << inst.name << "\n";
+                    return false;
+                }
+                build_clusters(mdl);
+                build_faces(mdl);
+                mdl.ps.assign(mdl.pm);
+                mdl.ns.assign(mdl.nml);
+                mdl_map[inst.name] = std::move(mdl);
+            }
+            if (ok)
+            {
+                inst.model = &mdl_map[inst.name];
+                inst.texture = tok.size() > 2 && tok[2] != "none" ? setup_texobj(tok[2]) : &blankTexture;
+                if (!inst.texture)
+                {
+                    std::cout << "ERROR: Unable to read texture file: " << tok[2]
+                        << " on line " << line_no << " in scene file: " << name << "\n";
+                    return false;
+                }
+                scene.push_back(std::move(inst));
+                continue;
+            }
+        }
+        std::cout << "ERROR: Invalid line " << line_no << " in scene file: "
+            << name << "\n";
+        return false;
+    }
+
+    for (Sampler const& sampler : samplers)
+    {
+        GLTexture& texture = textureMap.at(sampler.texture);
+        texture.wrap = sampler.wrap;
+        texture.filter = sampler.filter;
+    }
+    instances = std::move(scene);
+    current_instance = 0;
+    return true;
+}
+
 /*!***********************************************************************
 \brief Initializes the GLPbo object with the specified width and height.
 
@@ -294,76 +727,86 @@ void GLPbo::draw_fullwindow_quad() {
 \details This function initializes the GLPbo object by setting the width and height variables to the provided values.
 It calculates the total number of pixels (pixel_cnt) and bytes (byte_cnt) based on the width and height. The clear color is set to white (255, 255, 255).
 The texture object is created using glCreateTextures, with the target set to GL_TEXTURE_2D, and the storage is allocated using glTextureStorage2D with the format GL_RGBA8, and the width and height of the GLPbo object.
-The pixel buffer object (PBO) is created using glCreateBuffers, and the storage is allocated using glNamedBufferStorage.
-The storage size is determined by the byte count, and the storage flags include GL_DYNAMIC_STORAGE_BIT and GL_MAP_WRITE_BIT.
+ring_depth pixel buffer objects (PBOs) are created using glCreateBuffers and allocated using glNamedBufferStorage.
+The storage size is determined by the byte count, and the storage flags include GL_MAP_WRITE_BIT, GL_MAP_PERSISTENT_BIT and
+GL_MAP_COHERENT_BIT so that each PBO is mapped once with glMapNamedBufferRange and stays mapped until cleanup().
 The quad vertex array object (VAO) and the shader program are set up using the setup_quad_vao and setup_shdrpgm functions, respectively.
 
-\note This function assumes that the necessary variables and objects (texid, pboid, setup_quad_vao, and setup_shdrpgm) have been properly defined and implemented.
+With headless set, none of the GL objects above are created: frames are rendered into the host framebuffer host_fb
+and no GL context is required.
+
+\param ring_depth The number of PBOs in the ring. More PBOs let the emulator run further ahead of the GPU's copies
+at the cost of latency and memory.
+\param headless Whether to render into host memory without OpenGL.
+
+\note This function assumes that the necessary variables and objects (texid, pbo_ring, setup_quad_vao, and setup_shdrpgm) have been properly defined and implemented.
 
 *************************************************************************/
-void GLPbo::init(GLsizei w, GLsizei h) {
+void GLPbo::init(GLsizei w, GLsizei h, GLuint ring_depth, bool headless) {
     width = w;
     height = h;
+    is_headless = headless;
 
     pixel_cnt = w * h;
     byte_cnt = pixel_cnt * 4;
     
-    setup_texobj(CORE10::textureName);
-
-    depthBuffer = new double[pixel_cnt];
-
-    glm::mat4 view_port{
-    GLHelper::width * 0.5, 0                   , 0, 0,
-    0                  , GLHelper::height * 0.5, 0, 0,
-    0                  , 0                   , 1, 0,
-     GLHelper::width * 0.5, GLHelper::height * 0.5, 0, 1
-    };
-
-    glm::vec3 eye = CORE10::cam_pos;
-    glm::vec3 target = CORE10::target;
-    glm::vec3 up = glm::vec3(0.f, 1.f, 0.f);
-
-    glm::mat4 view{};
-    view = glm::lookAt(eye, target, up);
-
-    glm::mat4 ortho{};
-    float aspect_ratio = (float)GLPbo::width / (float)GLPbo::height;
-    CORE10::left_plane = aspect_ratio * CORE10::bottom_plane;
-    CORE10::right_plane = aspect_ratio * CORE10::top_plane;
-    ortho = glm::ortho(CORE10::left_plane, CORE10::right_plane, CORE10::bottom_plane, CORE10::top_plane, CORE10::near_plane, CORE10::far_plane);
+    depthBuffer = new float[pixel_cnt];
+    hiZBlocksX = (w + hiZBlockSize - 1) / hiZBlockSize;
+    // the PBO's initial contents are undefined, so every block is painted
+    hiZBuffer.assign(static_cast<size_t>(hiZBlocksX) * ((h + hiZBlockSize - 1) / hiZBlockSize),
+        HiZBlock{ 1.0f, 1.0f, false, false, true, false });
+    setup_tiles();
+    GLThreadPool::init();
 
-    view_chain = view_port * ortho * view;
+    set_camera(camera);
 
     set_clear_color(0,0,0);
 
-    glCreateTextures(GL_TEXTURE_2D, 1, &texid);
-
-    glTextureStorage2D(texid, 1, GL_RGBA8, width, height);
-
-    glCreateBuffers(1, &pboid);
+    if (is_headless)
+    {
+        // a single host framebuffer takes the place of the PBO ring
+        host_fb.assign(pixel_cnt, clear_clr);
+        pbo_ring.resize(1);
+        pbo_ring[0].id = 0;
+        pbo_ring[0].ptr = host_fb.data();
+        pbo_ring[0].fence = nullptr;
+        pbo_ring[0].painted.assign(hiZBuffer.size(), 0);
+    }
+    else
+    {
+        glCreateTextures(GL_TEXTURE_2D, 1, &texid);
 
-    glNamedBufferStorage(pboid,
-        byte_cnt,
-        nullptr,
-        GL_DYNAMIC_STORAGE_BIT | GL_MAP_WRITE_BIT);
+        glTextureStorage2D(texid, 1, GL_RGBA8, width, height);
 
-    for (const auto& x : CORE10::objectName)
-    {
-        GLPbo::mdl.pm.clear();
-        GLPbo::mdl.nml.clear();
-        GLPbo::mdl.tex.clear();
-        GLPbo::mdl.tri.clear();
-        if (DPML::parse_obj_mesh("../meshes/" + x + ".obj", mdl.pm, mdl.nml, mdl.tex, mdl.tri, true, true, true))
+        GLbitfield const pbo_flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        pbo_ring.resize(std::max(ring_depth, 1u));
+        for (PboSlot& slot : pbo_ring)
         {
-            mdl_map[x] = mdl;
+            glCreateBuffers(1, &slot.id);
+
+            glNamedBufferStorage(slot.id,
+                byte_cnt,
+                nullptr,
+                pbo_flags);
+            slot.ptr = static_cast<GLPbo::Color*>(glMapNamedBufferRange(slot.id, 0, byte_cnt, pbo_flags));
+            slot.fence = nullptr;
+            // the PBO's initial contents are undefined, so every block is painted
+            slot.painted.assign(hiZBuffer.size(), 1);
         }
     }
+    pbo_idx = 0;
 
-    current_mdl_iterator = mdl_map.begin();
+    if (!load_scene(CORE10::sceneName))
+    {
+        exit(EXIT_FAILURE);
+    }
 
-    viewport_xform(mdl);
-    setup_quad_vao();
-    setup_shdrpgm();
+    if (!is_headless)
+    {
+        setup_quad_vao();
+        setup_shdrpgm();
+        GLProfiler::init_gpu();
+    }
 }
 
 /*!***********************************************************************
@@ -477,17 +920,38 @@ void GLPbo::setup_shdrpgm() {
 /*!***********************************************************************
 \brief Cleans up the allocated resources.
 
-\details This function deletes the vertex array object (vaoid), pixel buffer object (pboid), and texture object (texid) using the corresponding OpenGL delete functions: glDeleteVertexArrays, glDeleteBuffers, and glDeleteTextures, respectively.
+\details This function deletes the vertex array object (vaoid), pixel buffer objects (pbo_ring), and texture object (texid) using the corresponding OpenGL delete functions: glDeleteVertexArrays, glDeleteBuffers, and glDeleteTextures, respectively.
+Pending fences are deleted and every PBO is unmapped before it is deleted.
 
-\note This function assumes that the necessary variables (vaoid, pboid, texid) have been properly defined and implemented.
+\note This function assumes that the necessary variables (vaoid, pbo_ring, texid) have been properly defined and implemented.
 
 *************************************************************************/
 void GLPbo::cleanup() {
+    GLThreadPool::cleanup();
+    delete[] depthBuffer;
+
+    if (is_headless)
+    {
+        pbo_ring.clear();
+        host_fb.clear();
+        return;
+    }
+
+    GLProfiler::cleanup_gpu();
     glInvalidateBufferData(texid);
     glDeleteTextures(1, &texid);
 
-    glInvalidateBufferData(pboid);
-    glDeleteBuffers(1, &pboid);
+    for (PboSlot& slot : pbo_ring)
+    {
+        if (slot.fence)
+        {
+            glDeleteSync(slot.fence);
+        }
+        glUnmapNamedBuffer(slot.id);
+        glInvalidateBufferData(slot.id);
+        glDeleteBuffers(1, &slot.id);
+    }
+    pbo_ring.clear();
 
     glInvalidateBufferData(vaoid);
     glDeleteBuffers(1, &vaoid);
@@ -505,6 +969,15 @@ void GLPbo::cleanup() {
 *************************************************************************/
 void GLPbo::set_clear_color(GLPbo::Color clr) {
     clear_clr = clr;
+    // pixels cleared to the old color must be cleared again
+    for (HiZBlock& block : hiZBuffer)
+    {
+        block.painted = true;
+    }
+    for (PboSlot& slot : pbo_ring)
+    {
+        std::fill(slot.painted.begin(), slot.painted.end(), 1);
+    }
 }
 
 /*!***********************************************************************
@@ -525,111 +998,883 @@ void GLPbo::set_clear_color(GLubyte r, GLubyte g, GLubyte b, GLubyte a) {
     clear_clr.rgba.g = g;
     clear_clr.rgba.b = b;
     clear_clr.rgba.a = a;
+    // pixels cleared to the old color must be cleared again
+    for (HiZBlock& block : hiZBuffer)
+    {
+        block.painted = true;
+    }
+    for (PboSlot& slot : pbo_ring)
+    {
+        std::fill(slot.painted.begin(), slot.painted.end(), 1);
+    }
 }
 
 /*!***********************************************************************
 \brief Clears the color buffer of the GLPbo.
 
-\details This function fills the color buffer of the GLPbo with the clear color (clear_clr) using the std::fill algorithm.
+\details This function does not write to the PBO. Every block that was painted since it was last cleared is
+flagged, and its pixels are filled with clear_clr by prepare_block() when a triangle first reaches the block or by
+resolve_tile() at the end of the frame. Blocks that still hold the clear color are never written.
 
-\note This function assumes that ptr_to_pbo and pixel_cnt have been properly defined and implemented, and that clear_clr represents the desired clear color.
+\note This function assumes that the PBO keeps its contents between frames.
 
 *************************************************************************/
 void GLPbo::clear_color_buffer() {
-    // FPS: 510
-    std::fill(ptr_to_pbo, ptr_to_pbo + pixel_cnt, clear_clr);
+    for (HiZBlock& block : hiZBuffer)
+    {
+        block.color_pending = block.painted;
+    }
 }
 
+/*!***********************************************************************
+\brief Clears the depth buffer of the GLPbo.
+
+\details The Hi-Z range of every block is reset to the far plane and the block's depth values are flagged as
+stale. They are filled with the far depth by prepare_block() when a triangle first reaches the block.
+
+*************************************************************************/
 void GLPbo::clear_depth_buffer()
 {
-    std::fill(depthBuffer, depthBuffer + pixel_cnt, 1.0);
+    for (HiZBlock& block : hiZBuffer)
+    {
+        block.zmin = block.zmax = 1.0f;
+        block.dirty = false;
+        block.depth_valid = false;
+    }
 }
 
 /**
-@brief Applies viewport transformation to the given model.
-This function applies a viewport transformation to the specified model.
-It clears the model's point data and then performs rotation and viewport transformations on each point.
-The rotated points are converted to a vec4 and multiplied by the viewport matrix to obtain the transformed points.
-The resulting transformed points are stored in the model's point data vector.
+@brief Performs the deferred clears of a block before its pixels are written.
 
-@param mdl The model to apply the viewport transformation to.
+@param block The block to prepare.
+@param bx The x coordinate of the block's left column.
+@param by The y coordinate of the block's bottom row.
 */
-void GLPbo::viewport_xform(Model& model) {
-
-    model.pd.clear();
-    radians = glm::radians(model.angle);
-    light_rad = glm::radians(light_angle);
-   
-     glm::mat3 m_rotation = { cos(radians),  0, -sin(radians),
-                          0,  1,  0,
-                          sin(radians), 0, cos(radians) };
-
-     if (zAxisRotate)
-     {
-         m_rotation = glm::rotate(radians, glm::normalize(glm::vec3(0, 1, 1)));
-
-     }
-     if (xAxisRotate)
-     {
-         m_rotation = glm::rotate(radians, glm::normalize(glm::vec3(1, 1, 0)));
-
-     }
-     if (xAxisRotate && zAxisRotate)
-     {
-         m_rotation = glm::rotate(radians, glm::normalize(glm::vec3(1, 1, 1)));
-     }
-    double scale_val; 
-
-    if (current_mdl_iterator->first == "cube")
-    {
-        scale_val = 1.5;
-    }
-    else
+static void prepare_block(HiZBlock& block, int bx, int by)
+{
+    if (block.depth_valid && !block.color_pending)
     {
-        scale_val = 2;
+        return;
     }
-    
-    glm::mat3 scale
+    int x1 = std::min(bx + hiZBlockSize, static_cast<int>(GLPbo::width));
+    int y1 = std::min(by + hiZBlockSize, static_cast<int>(GLPbo::height));
+    for (int y = by; y < y1; ++y)
     {
-            scale_val,  0,          0,
-            0,          scale_val,  0,
-            0,          0,          scale_val
-    };
-
-    model.ModelTrans = m_rotation;
-
-    glm::mat3 model_trans = scale * m_rotation;
-
-    for (size_t i = 0; i < model.pm.size(); i++)
-    {   
-        //Apply the scale and rotation
-        glm::vec3 scale_rot = model_trans * model.pm[i];
-
-        // Convert the rotated vec3 to a vec4
-        glm::vec4 rotated4(scale_rot, 1.0f);
-
-        // Apply the viewport transformation
-        glm::vec4 transformed = view_chain * rotated4;
-        model.pd.push_back(glm::vec3(transformed));
+        size_t row = static_cast<size_t>(y) * GLPbo::width;
+        if (!block.depth_valid)
+        {
+            std::fill(depthBuffer + row + bx, depthBuffer + row + x1, 1.0f);
+        }
+        if (block.color_pending)
+        {
+            std::fill(GLPbo::ptr_to_pbo + row + bx, GLPbo::ptr_to_pbo + row + x1, GLPbo::clear_clr);
+        }
     }
+    block.depth_valid = true;
+    block.color_pending = false;
+    block.painted = false;
 }
 
 /**
-@brief Sets the color of a pixel at the specified coordinates.
-This function sets the color of a pixel at the given (x, y) coordinates.
-It uses the glScissor function to define the scissor box to cover the entire viewport.
-The position of the pixel in the PBO (Pixel Buffer Object) is calculated based on the width and the provided (x, y) coordinates.
-The color value is then assigned to the corresponding position in the PBO.
+@brief Resolves the deferred color clear of the blocks in a tile.
+Blocks that were flagged by clear_color_buffer() but not reached by any
+triangle this frame still hold the previous frame's pixels and are cleared
+here.
 
-@param x The x-coordinate of the pixel.
-@param y The y-coordinate of the pixel.
-@param clr The color to set for the pixel.
+@param tile The tile to resolve.
 */
-void GLPbo::set_pixel(int x, int y, Color clr)
+void GLPbo::resolve_tile(Tile const& tile)
 {
-   glScissor(0, 0, GLHelper::width, GLHelper::height);
-    int position = (GLPbo::width * y) + x;
-    ptr_to_pbo[position] = clr;
+    for (GLint by = tile.y0; by < tile.y1; by += hiZBlockSize)
+    {
+        for (GLint bx = tile.x0; bx < tile.x1; bx += hiZBlockSize)
+        {
+            HiZBlock& block = hiZBuffer[static_cast<size_t>(by / hiZBlockSize) * hiZBlocksX + bx / hiZBlockSize];
+            if (block.color_pending)
+            {
+                int x1 = std::min(bx + hiZBlockSize, tile.x1);
+                int y1 = std::min(by + hiZBlockSize, tile.y1);
+                for (int y = by; y < y1; ++y)
+                {
+                    size_t row = static_cast<size_t>(y) * width;
+                    std::fill(ptr_to_pbo + row + bx, ptr_to_pbo + row + x1, clear_clr);
+                }
+                block.color_pending = false;
+                block.painted = false;
+            }
+        }
+    }
+}
+
+/**
+@brief Groups the triangles of a model into clusters.
+Every cluster holds cluster_tris consecutive triangles (the last one may hold
+fewer) and is bounded by the sphere centered on the center of the bounding
+box of its vertices. The whole model is bounded the same way, so that
+viewport_xform() can cull instances before any of their vertices are
+transformed.
+
+@param model The model whose arrays pm and tri are loaded.
+*/
+void GLPbo::build_clusters(Model& model)
+{
+    // sphere centered on the bounding box of the vertices tri[first, last)
+    auto bound = [&model](GLuint first, GLuint last, glm::vec3& center, float& radius)
+    {
+        glm::vec3 lo = model.pm[model.tri[first]], hi = lo;
+        for (GLuint i = first; i < last; ++i)
+        {
+            lo = glm::min(lo, model.pm[model.tri[i]]);
+            hi = glm::max(hi, model.pm[model.tri[i]]);
+        }
+        center = (lo + hi) * 0.5f;
+        radius = 0.0f;
+        for (GLuint i = first; i < last; ++i)
+        {
+            radius = std::max(radius, glm::length(model.pm[model.tri[i]] - center));
+        }
+    };
+
+    model.clusters.clear();
+    for (GLuint first = 0; first < model.tri.size(); first += 3 * cluster_tris)
+    {
+        GLuint count = std::min(3 * cluster_tris, static_cast<GLuint>(model.tri.size()) - first);
+        Model::Cluster cluster{ first, count, {}, 0.0f };
+        bound(first, first + count, cluster.center, cluster.radius);
+        model.clusters.push_back(cluster);
+    }
+    model.center = glm::vec3(0.0f);
+    model.radius = 0.0f;
+    if (!model.tri.empty())
+    {
+        bound(0, static_cast<GLuint>(model.tri.size()), model.center, model.radius);
+    }
+}
+
+/**
+@brief Computes the unit normal and the centroid of every triangle of a model.
+The faceted shading modes light every triangle with these instead of
+recomputing them from the vertex positions for every tile the triangle
+overlaps.
+
+@param model The model whose arrays pm and tri are loaded.
+*/
+void GLPbo::build_faces(Model& model)
+{
+    size_t tri_cnt = model.tri.size() / 3;
+    model.fn.resize(tri_cnt);
+    model.fc.resize(tri_cnt);
+    for (size_t f = 0; f < tri_cnt; ++f)
+    {
+        glm::dvec3 p0 = model.pm[model.tri[3 * f]];
+        glm::dvec3 p1 = model.pm[model.tri[3 * f + 1]];
+        glm::dvec3 p2 = model.pm[model.tri[3 * f + 2]];
+        glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);
+        double len = glm::length(n);
+        model.fn[f] = len > 0.0 ? glm::vec3(n / len) : glm::vec3(0.0f);
+        model.fc[f] = glm::vec3((p0 + p1 + p2) / 3.0);
+    }
+}
+
+/**
+@brief Splits the framebuffer into tiles of tile_size x tile_size pixels.
+Tiles along the right and top borders are truncated to the framebuffer.
+*/
+void GLPbo::setup_tiles()
+{
+    tiles_x = (width + tile_size - 1) / tile_size;
+    tiles_y = (height + tile_size - 1) / tile_size;
+    tiles.resize(static_cast<size_t>(tiles_x) * tiles_y);
+
+    for (GLint ty = 0; ty < tiles_y; ++ty)
+    {
+        for (GLint tx = 0; tx < tiles_x; ++tx)
+        {
+            Tile& tile = tiles[static_cast<size_t>(ty) * tiles_x + tx];
+            tile.x0 = tx * tile_size;
+            tile.y0 = ty * tile_size;
+            tile.x1 = std::min(tile.x0 + tile_size, width);
+            tile.y1 = std::min(tile.y0 + tile_size, height);
+        }
+    }
+}
+
+/**
+@brief Classifies the triangles of the scene and compacts the visible ones.
+Every job of the first pass handles up to cullJobClusters clusters of one
+visible instance, so the jobs of small and large instances are of similar
+size. A cluster whose bounding sphere lies outside the viewport or beyond
+the near or far plane is off-screen as a whole; the triangles of other
+clusters are classified one by one as back-facing, zero-area, off-screen
+(outside one of the clipping planes or with a bounding box that misses the
+viewport) or visible. Triangles with a vertex behind the eye are only tested
+against the clipping planes, and their facing is left to the rasterizer. The
+visible counts of the jobs are then scanned into output offsets and a second
+pass writes the visible triangles to visible_tris in the order of the
+instances and, within an instance, in their original order.
+
+Instances culled by viewport_xform() have no jobs; their triangles are not
+counted in cull_stats, which counts the instances instead.
+*/
+void GLPbo::cull_triangles()
+{
+    cull_stats = CullStats{};
+    cullJobs.clear();
+    size_t tri_cnt = 0;
+    for (GLuint n = 0; n < instances.size(); ++n)
+    {
+        Instance const& inst = instances[n];
+        if (!inst.visible)
+        {
+            ++cull_stats.instances;
+            continue;
+        }
+        std::vector<Model::Cluster> const& clusters = inst.model->clusters;
+        for (size_t k = 0; k < clusters.size(); k += cullJobClusters)
+        {
+            CullJob job{};
+            job.inst = n;
+            job.first = static_cast<GLuint>(k);
+            job.last = static_cast<GLuint>(std::min(k + cullJobClusters, clusters.size()));
+            job.class_base = tri_cnt + clusters[k].first / 3;
+            cullJobs.push_back(job);
+        }
+        tri_cnt += inst.model->tri.size() / 3;
+    }
+    triClass.resize(tri_cnt);
+    GLuint jobs = static_cast<GLuint>(cullJobs.size());
+
+    GLThreadPool::parallel_for(jobs, [](GLuint job, GLuint)
+    {
+        CullJob& counts = cullJobs[job];
+        Instance const& inst = instances[counts.inst];
+        Model const& model = *inst.model;
+        // index in triClass of the triangle at offset 0 in Model::tri
+        size_t base = counts.class_base - model.clusters[counts.first].first / 3;
+        for (GLuint k = counts.first; k < counts.last; ++k)
+        {
+            Model::Cluster const& cluster = model.clusters[k];
+            // pad the radius so that rounding never culls a visible triangle
+            float r = cluster.radius * 1.0001f + 1e-4f;
+            bool outside = false;
+            for (glm::vec4 const& plane : inst.frustum)
+            {
+                outside = outside || glm::dot(glm::vec3(plane), cluster.center) + plane.w + r <= 0.0f;
+            }
+            if (outside)
+            {
+                std::fill_n(triClass.begin() + base + cluster.first / 3, cluster.count / 3, tri_offscreen);
+                counts.count[tri_offscreen] += cluster.count / 3;
+                ++counts.clusters;
+                continue;
+            }
+
+            for (size_t i = cluster.first; i < cluster.first + cluster.count; i += 3)
+            {
+                GLuint i0 = model.tri[i], i1 = model.tri[i + 1], i2 = model.tri[i + 2];
+                double x0 = inst.pd.x[i0], y0 = inst.pd.y[i0];
+                double x1 = inst.pd.x[i1], y1 = inst.pd.y[i1];
+                double x2 = inst.pd.x[i2], y2 = inst.pd.y[i2];
+
+                TriClass c = tri_visible;
+                if (!(inst.pw[i0] > 0.0f && inst.pw[i1] > 0.0f && inst.pw[i2] > 0.0f))
+                {
+                    // a vertex is behind the eye, so the window coordinates
+                    // are meaningless; facing and extent are decided by the
+                    // rasterizer after the triangle is clipped
+                    if (inst.oc[i0] & inst.oc[i1] & inst.oc[i2])
+                    {
+                        c = tri_offscreen;
+                    }
+                    triClass[base + i / 3] = c;
+                    ++counts.count[c];
+                    continue;
+                }
+
+                double area = (x1 - x0) * (y2 - y0) - (y1 - y0) * (x2 - x0);
+                if (area < 0.0)
+                {
+                    c = tri_backfaced;
+                }
+                else if (area == 0.0)
+                {
+                    c = tri_zero_area;
+                }
+                else if ((inst.oc[i0] & inst.oc[i1] & inst.oc[i2])
+                    || std::max({ x0, x1, x2 }) <= 0.0 || std::min({ x0, x1, x2 }) >= width
+                    || std::max({ y0, y1, y2 }) <= 0.0 || std::min({ y0, y1, y2 }) >= height)
+                {
+                    c = tri_offscreen;
+                }
+                triClass[base + i / 3] = c;
+                ++counts.count[c];
+            }
+        }
+    });
+
+    // exclusive scan of the visible counts gives each job its output range
+    GLuint total = 0;
+    for (CullJob& counts : cullJobs)
+    {
+        counts.offset = total;
+        total += counts.count[tri_visible];
+        cull_stats.backfaced += counts.count[tri_backfaced];
+        cull_stats.zero_area += counts.count[tri_zero_area];
+        cull_stats.offscreen += counts.count[tri_offscreen];
+        cull_stats.clusters += counts.clusters;
+    }
+    cull_stats.visible = total;
+    visible_tris.resize(total);
+
+    GLThreadPool::parallel_for(jobs, [](GLuint job, GLuint)
+    {
+        CullJob const& counts = cullJobs[job];
+        Model const& model = *instances[counts.inst].model;
+        size_t base = counts.class_base - model.clusters[counts.first].first / 3;
+        GLuint out = counts.offset;
+        GLuint first = model.clusters[counts.first].first;
+        GLuint last = model.clusters[counts.last - 1].first + model.clusters[counts.last - 1].count;
+        for (GLuint i = first; i < last; i += 3)
+        {
+            if (triClass[base + i / 3] == tri_visible)
+            {
+                visible_tris[out++] = { counts.inst, i };
+            }
+        }
+    });
+}
+
+/**
+@brief Sorts the visible triangles of the scene into screen tiles.
+Triangles in visible_tris that cross a clipping plane are replaced by their
+clipped pieces, and every triangle or piece is appended to the list of each
+tile that its bounding box overlaps. Bounding boxes are clamped to the
+viewport here, so off-screen parts of a triangle are never visited.
+Triangles of instances drawn as wireframes are drawn by emulate() instead
+and are not binned. visible_tris is sorted by instance, so the lists of
+every tile are too.
+*/
+void GLPbo::bin_triangles()
+{
+    for (Tile& tile : tiles)
+    {
+        tile.tris.clear();
+        tile.clipped.clear();
+    }
+    clipped_tris.clear();
+
+    // append id to the given list of every tile overlapped by the bounding
+    // box of triangle p0, p1, p2
+    auto bin = [](glm::dvec3 const& p0, glm::dvec3 const& p1, glm::dvec3 const& p2, auto list, auto id)
+    {
+        int minX = int_only(floor(std::min({ p0.x, p1.x, p2.x })));
+        int maxX = int_only(ceil(std::max({ p0.x, p1.x, p2.x })));
+        int minY = int_only(floor(std::min({ p0.y, p1.y, p2.y })));
+        int maxY = int_only(ceil(std::max({ p0.y, p1.y, p2.y })));
+        if (maxX <= 0 || maxY <= 0 || minX >= width || minY >= height)
+        {
+            return;
+        }
+        int tx0 = std::max(minX, 0) / tile_size;
+        int ty0 = std::max(minY, 0) / tile_size;
+        int tx1 = std::min(maxX - 1, width - 1) / tile_size;
+        int ty1 = std::min(maxY - 1, height - 1) / tile_size;
+
+        for (int ty = ty0; ty <= ty1; ++ty)
+        {
+            for (int tx = tx0; tx <= tx1; ++tx)
+            {
+                (tiles[static_cast<size_t>(ty) * tiles_x + tx].*list).push_back(id);
+            }
+        }
+    };
+
+    for (TriRef const& ref : visible_tris)
+    {
+        Instance const& inst = instances[ref.inst];
+        if (inst.Tasking == Model::task::wireframe)
+        {
+            continue;
+        }
+        std::vector<GLuint> const& tri = inst.model->tri;
+        GLuint i = ref.tri;
+        glm::dvec3 p0 = inst.pd[tri[i]];
+        glm::dvec3 p1 = inst.pd[tri[i + 1]];
+        glm::dvec3 p2 = inst.pd[tri[i + 2]];
+
+        if ((inst.oc[tri[i]] | inst.oc[tri[i + 1]] | inst.oc[tri[i + 2]]) == 0)
+        {
+            bin(p0, p1, p2, &Tile::tris, ref);
+            continue;
+        }
+
+        size_t first = clipped_tris.size();
+        clip_triangle(ref.inst, i);
+        for (size_t c = first; c < clipped_tris.size(); ++c)
+        {
+            glm::dvec4 const* p = clipped_tris[c].p;
+            bin(glm::dvec3(p[0]), glm::dvec3(p[1]), glm::dvec3(p[2]), &Tile::clipped, static_cast<GLuint>(c));
+        }
+    }
+}
+
+/**
+@brief Clips a triangle against the near, far and guard band planes.
+The triangle is clipped with the Sutherland-Hodgman algorithm in clip
+coordinates (with the viewport transform applied), which are recomputed from
+the model coordinates since the window coordinates of a vertex behind the eye
+are meaningless. Vertex attributes are linear in clip coordinates, so the
+barycentric weights of the source triangle are clipped along with the
+positions. The resulting convex polygon is split into a triangle fan and
+every triangle is appended to clipped_tris with its vertices expressed as
+barycentric weights of the source triangle, window coordinates and reciprocal
+clip w.
+
+@param inst Index of the triangle's instance in instances.
+@param tri Offset of the triangle's first index in Model::tri.
+*/
+void GLPbo::clip_triangle(GLuint inst, GLuint tri)
+{
+    Instance const& instance = instances[inst];
+    Model const& model = *instance.model;
+    // vertex p is inside a plane when sign * p[axis] <= offset * p.w
+    struct Plane { int axis; double sign, offset; };
+    static constexpr Plane planes[] = {
+        { 2, -1.0, 1.0 },        { 2, 1.0, 1.0 },        // near, far
+        { 0, -1.0, guard_band }, { 0, 1.0, guard_band }, // left, right
+        { 1, -1.0, guard_band }, { 1, 1.0, guard_band }, // bottom, top
+    };
+    // every plane adds at most one vertex to a convex polygon
+    constexpr int max_verts = 3 + 6;
+
+    glm::dvec4 pos[2][max_verts];
+    glm::dvec3 wgt[2][max_verts];
+    for (int v = 0; v < 3; ++v)
+    {
+        pos[0][v] = glm::dvec4(instance.xform * glm::vec4(model.ps[model.tri[tri + v]], 1.0f));
+        wgt[0][v] = glm::dvec3(0.0);
+        wgt[0][v][v] = 1.0;
+    }
+    int cnt = 3, cur = 0;
+
+    for (Plane const& plane : planes)
+    {
+        int nxt = 1 - cur, n = 0;
+        for (int i = 0; i < cnt; ++i)
+        {
+            int j = (i + 1) % cnt;
+            double di = plane.sign * pos[cur][i][plane.axis] - plane.offset * pos[cur][i].w;
+            double dj = plane.sign * pos[cur][j][plane.axis] - plane.offset * pos[cur][j].w;
+            if (di <= 0.0)
+            {
+                pos[nxt][n] = pos[cur][i];
+                wgt[nxt][n++] = wgt[cur][i];
+            }
+            if ((di <= 0.0) != (dj <= 0.0))
+            {
+                double t = di / (di - dj);
+                pos[nxt][n] = pos[cur][i] + t * (pos[cur][j] - pos[cur][i]);
+                wgt[nxt][n++] = wgt[cur][i] + t * (wgt[cur][j] - wgt[cur][i]);
+            }
+        }
+        cnt = n;
+        cur = nxt;
+        if (cnt < 3)
+        {
+            return;
+        }
+    }
+
+    // the near and far planes leave w > 0, so the division is safe
+    glm::dvec4 win[max_verts];
+    for (int i = 0; i < cnt; ++i)
+    {
+        double rw = 1.0 / pos[cur][i].w;
+        win[i] = glm::dvec4(glm::dvec3(pos[cur][i]) * rw, rw);
+    }
+    for (int i = 1; i + 1 < cnt; ++i)
+    {
+        clipped_tris.push_back({ inst, tri, { wgt[cur][0], wgt[cur][i], wgt[cur][i + 1] }, { win[0], win[i], win[i + 1] } });
+    }
+}
+
+namespace VERTEX
+{
+    // vertices per job when the vertex stage is split across threads
+    constexpr size_t batch_size = 4096;
+
+    // Jobs of the vertex and lighting stages. A job is a list of ranges
+    // [first, last) of the vertices of one or more instances that holds
+    // about batch_size vertices: large instances are split over several
+    // jobs and small ones are packed together, so that the work of a scene
+    // of any mix of instances is spread evenly over the worker threads.
+    struct Range {
+        GLuint inst;
+        size_t first, last;
+    };
+    std::vector<Range> ranges;
+    std::vector<size_t> jobs; // first range of every job, then ranges.size()
+
+    /**
+    @brief Runs work(inst, first, last) over the vertices of some instances.
+    The vertices of every instance for which use(inst) is true are split into
+    jobs that are run on the worker threads; a single job runs on the calling
+    thread.
+    */
+    template <typename Use, typename Work>
+    void for_each_batch(Use&& use, Work&& work)
+    {
+        ranges.clear();
+        jobs.assign(1, 0);
+        size_t job_vertices = 0;
+        for (GLuint n = 0; n < GLPbo::instances.size(); ++n)
+        {
+            GLPbo::Instance const& inst = GLPbo::instances[n];
+            if (!use(inst))
+            {
+                continue;
+            }
+            size_t vtx_cnt = inst.model->pm.size();
+            for (size_t first = 0; first < vtx_cnt; first += batch_size)
+            {
+                size_t last = std::min(first + batch_size, vtx_cnt);
+                if (job_vertices > 0 && job_vertices + (last - first) > batch_size)
+                {
+                    jobs.push_back(ranges.size());
+                    job_vertices = 0;
+                }
+                ranges.push_back({ n, first, last });
+                job_vertices += last - first;
+            }
+        }
+        if (job_vertices > 0)
+        {
+            jobs.push_back(ranges.size());
+        }
+
+        auto run = [&work](GLuint job, GLuint)
+        {
+            for (size_t r = jobs[job]; r < jobs[job + 1]; ++r)
+            {
+                work(GLPbo::instances[ranges[r].inst], ranges[r].first, ranges[r].last);
+            }
+        };
+        GLuint job_cnt = static_cast<GLuint>(jobs.size() - 1);
+        if (job_cnt == 1)
+        {
+            run(0, 0);
+        }
+        else if (job_cnt > 1)
+        {
+            GLThreadPool::parallel_for(job_cnt, run);
+        }
+    }
+
+#if defined(__AVX2__)
+    constexpr int lanes = 8;
+    using vfloat = __m256;
+    inline vfloat splat(float v) { return _mm256_set1_ps(v); }
+    inline vfloat load(float const* p) { return _mm256_loadu_ps(p); }
+    inline void store(float* p, vfloat v) { _mm256_storeu_ps(p, v); }
+    inline vfloat madd(vfloat a, vfloat b, vfloat c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+    inline vfloat sub(vfloat a, vfloat b) { return _mm256_sub_ps(a, b); }
+    inline vfloat mul(vfloat a, vfloat b) { return _mm256_mul_ps(a, b); }
+    inline vfloat div(vfloat a, vfloat b) { return _mm256_div_ps(a, b); }
+    inline vfloat sqrt(vfloat a) { return _mm256_sqrt_ps(a); }
+    inline vfloat max(vfloat a, vfloat b) { return _mm256_max_ps(a, b); }
+    // bit k is set if lane k of a is less than lane k of b
+    inline unsigned less(vfloat a, vfloat b) { return static_cast<unsigned>(_mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LT_OQ))); }
+#else
+    constexpr int lanes = 4;
+    using vfloat = __m128;
+    inline vfloat splat(float v) { return _mm_set1_ps(v); }
+    inline vfloat load(float const* p) { return _mm_loadu_ps(p); }
+    inline void store(float* p, vfloat v) { _mm_storeu_ps(p, v); }
+    inline vfloat madd(vfloat a, vfloat b, vfloat c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+    inline vfloat sub(vfloat a, vfloat b) { return _mm_sub_ps(a, b); }
+    inline vfloat mul(vfloat a, vfloat b) { return _mm_mul_ps(a, b); }
+    inline vfloat div(vfloat a, vfloat b) { return _mm_div_ps(a, b); }
+    inline vfloat sqrt(vfloat a) { return _mm_sqrt_ps(a); }
+    inline vfloat max(vfloat a, vfloat b) { return _mm_max_ps(a, b); }
+    // bit k is set if lane k of a is less than lane k of b
+    inline unsigned less(vfloat a, vfloat b) { return static_cast<unsigned>(_mm_movemask_ps(_mm_cmplt_ps(a, b))); }
+#endif
+
+    /**
+    @brief Returns the outcode of a vertex in clip coordinates.
+    The vertex is tested before the division by w, so the outcode is also
+    correct for vertices behind the eye. The near and far planes are at
+    z = -w and z = w and the other planes bound the guard band, i.e. window
+    coordinates x * w and y * w of +/- GLPbo::guard_band.
+    */
+    inline unsigned char outcode(float x, float y, float z, float w)
+    {
+        float const g = static_cast<float>(GLPbo::guard_band) * w;
+        return static_cast<unsigned char>((z < -w ? GLPbo::clip_near : 0) | (z > w ? GLPbo::clip_far : 0)
+            | (x < -g ? GLPbo::clip_left : 0) | (x > g ? GLPbo::clip_right : 0)
+            | (y < -g ? GLPbo::clip_bottom : 0) | (y > g ? GLPbo::clip_top : 0));
+    }
+}
+
+/**
+@brief Transforms a range of a model's vertices.
+Positions are read from the structure of arrays ps in batches of
+VERTEX::lanes (8 with AVX2, 4 with SSE2) and multiplied by the premultiplied
+matrix xform. The outcode of every vertex is computed in clip coordinates
+and written to oc; the reciprocal of clip w is then computed once and written
+to pw, and the window coordinates - the clip coordinates times that
+reciprocal - to pd. The last few vertices that do not fill a batch are
+transformed one at a time.
+
+@param inst The instance whose xform was set by viewport_xform().
+@param first The first vertex to transform.
+@param last One past the last vertex to transform.
+*/
+void GLPbo::transform_vertices(Instance& inst, size_t first, size_t last)
+{
+    using namespace VERTEX;
+    glm::mat4 const& xform = inst.xform;
+    float const* sx = inst.model->ps.x.data();
+    float const* sy = inst.model->ps.y.data();
+    float const* sz = inst.model->ps.z.data();
+    float* dx = inst.pd.x.data();
+    float* dy = inst.pd.y.data();
+    float* dz = inst.pd.z.data();
+    float* dw = inst.pw.data();
+    unsigned char* oc = inst.oc.data();
+
+    vfloat m[4][4];
+    for (int c = 0; c < 4; ++c)
+    {
+        for (int r = 0; r < 4; ++r)
+        {
+            m[c][r] = splat(xform[c][r]);
+        }
+    }
+    float const g = static_cast<float>(guard_band);
+    vfloat const zero = splat(0.0f), one = splat(1.0f), glo = splat(-g), ghi = splat(g);
+
+    size_t i = first;
+    for (; i + lanes <= last; i += lanes)
+    {
+        vfloat x = load(sx + i), y = load(sy + i), z = load(sz + i);
+        vfloat out[4];
+        for (int r = 0; r < 4; ++r)
+        {
+            out[r] = madd(m[0][r], x, madd(m[1][r], y, madd(m[2][r], z, m[3][r])));
+        }
+        vfloat gw0 = mul(glo, out[3]), gw1 = mul(ghi, out[3]);
+        unsigned mask[6] = {
+            less(out[2], sub(zero, out[3])), less(out[3], out[2]),
+            less(out[0], gw0), less(gw1, out[0]),
+            less(out[1], gw0), less(gw1, out[1]),
+        };
+        vfloat rw = div(one, out[3]);
+        store(dx + i, mul(out[0], rw));
+        store(dy + i, mul(out[1], rw));
+        store(dz + i, mul(out[2], rw));
+        store(dw + i, rw);
+
+        for (int k = 0; k < lanes; ++k)
+        {
+            unsigned code = 0;
+            for (int b = 0; b < 6; ++b)
+            {
+                code |= ((mask[b] >> k) & 1u) << b;
+            }
+            oc[i + k] = static_cast<unsigned char>(code);
+        }
+    }
+    for (; i < last; ++i)
+    {
+        glm::vec4 p = xform * glm::vec4(sx[i], sy[i], sz[i], 1.0f);
+        oc[i] = VERTEX::outcode(p.x, p.y, p.z, p.w);
+        float rw = 1.0f / p.w;
+        dx[i] = p.x * rw;
+        dy[i] = p.y * rw;
+        dz[i] = p.z * rw;
+        dw[i] = rw;
+    }
+}
+
+/**
+@brief Computes the diffuse terms of a range of an instance's vertices.
+The diffuse term of a vertex is max(0, n . l) where n is the vertex normal and
+l the unit vector from the vertex to the light, both in model coordinates.
+Normals and positions are read from the structures of arrays ns and ps in
+batches of VERTEX::lanes vertices.
+
+@param inst The instance whose light was set by setup_lighting().
+@param first The first vertex to light.
+@param last One past the last vertex to light.
+*/
+void GLPbo::light_vertices(Instance& inst, size_t first, size_t last)
+{
+    using namespace VERTEX;
+    Model const& model = *inst.model;
+    float const lx = static_cast<float>(inst.light.x);
+    float const ly = static_cast<float>(inst.light.y);
+    float const lz = static_cast<float>(inst.light.z);
+    float* vd = inst.vd.data();
+
+    size_t i = first;
+    vfloat const vlx = splat(lx), vly = splat(ly), vlz = splat(lz), zero = splat(0.0f);
+    for (; i + lanes <= last; i += lanes)
+    {
+        vfloat dx = sub(vlx, load(model.ps.x.data() + i));
+        vfloat dy = sub(vly, load(model.ps.y.data() + i));
+        vfloat dz = sub(vlz, load(model.ps.z.data() + i));
+        vfloat len = VERTEX::sqrt(madd(dx, dx, madd(dy, dy, mul(dz, dz))));
+        vfloat nl = madd(load(model.ns.x.data() + i), dx,
+            madd(load(model.ns.y.data() + i), dy, mul(load(model.ns.z.data() + i), dz)));
+        store(vd + i, VERTEX::max(div(nl, len), zero));
+    }
+    for (; i < last; ++i)
+    {
+        glm::vec3 l = glm::normalize(glm::vec3(lx, ly, lz) - model.ps[i]);
+        vd[i] = std::max(0.0f, glm::dot(model.ns[i], l));
+    }
+}
+
+/**
+@brief Sets up the lighting of the visible instances for the current frame.
+The light is rotated with the scene whereas the vertices of the models are
+not, so the light is brought into the model space of every instance once
+with the inverse of its rotation, about the instance's position. For the
+smooth shading modes, the diffuse term of every vertex is then computed by
+light_vertices(); the vertices of all such instances are lit together, on
+the worker threads in jobs of about VERTEX::batch_size vertices.
+*/
+void GLPbo::setup_lighting()
+{
+    auto smooth = [](Instance const& inst)
+    {
+        return inst.visible
+            && (inst.Tasking == Model::task::shaded || inst.Tasking == Model::task::smooth_tex);
+    };
+    for (Instance& inst : instances)
+    {
+        if (!inst.visible)
+        {
+            continue;
+        }
+        inst.light = glm::inverse(inst.ModelTrans) * (glm::vec3(CORE10::light_pos_rotated) - inst.position);
+        if (smooth(inst))
+        {
+            inst.vd.resize(inst.model->pm.size());
+        }
+    }
+    VERTEX::for_each_batch(smooth, light_vertices);
+}
+
+/**
+@brief Applies the model and viewport transformations to every instance.
+The rotation, scale and translation of an instance and the view chain are
+premultiplied once into the instance's xform. Rather than transforming the
+bounding sphere of every cluster, the planes that bound the viewport and the
+depth range are brought into model coordinates once: a plane
+a . (x, y, z, w) >= 0 in clip coordinates is the plane (a^T xform) . (p, 1)
+>= 0 in model coordinates, for either projection. The planes are normalized
+so that the bounding spheres of the model and of its clusters can be
+compared with them directly; an instance whose model's sphere is outside a
+plane is not visible and skips the rest of the frame.
+The vertex stage transform_vertices() then applies xform to every vertex of
+the visible instances. Their vertices are processed together on the worker
+threads in jobs of about VERTEX::batch_size vertices, so a scene of many
+small instances is spread over the threads as well as one large model. The
+window coordinates, reciprocal w and outcodes overwrite the instance's
+arrays, which are only resized if the number of vertices changed.
+*/
+void GLPbo::viewport_xform() {
+
+    light_rad = glm::radians(light_angle);
+    float const w = static_cast<float>(width), h = static_cast<float>(height);
+
+    for (Instance& inst : instances)
+    {
+        radians = glm::radians(inst.angle);
+
+        glm::mat3 m_rotation = { cos(radians),  0, -sin(radians),
+                             0,  1,  0,
+                             sin(radians), 0, cos(radians) };
+
+        if (zAxisRotate)
+        {
+            m_rotation = glm::rotate(radians, glm::normalize(glm::vec3(0, 1, 1)));
+
+        }
+        if (xAxisRotate)
+        {
+            m_rotation = glm::rotate(radians, glm::normalize(glm::vec3(1, 1, 0)));
+
+        }
+        if (xAxisRotate && zAxisRotate)
+        {
+            m_rotation = glm::rotate(radians, glm::normalize(glm::vec3(1, 1, 1)));
+        }
+
+        glm::mat3 scale
+        {
+                inst.scale, 0,          0,
+                0,          inst.scale, 0,
+                0,          0,          inst.scale
+        };
+
+        inst.ModelTrans = m_rotation;
+
+        // scale and rotation about the model's origin, then translation
+        glm::mat4 model_to_world = glm::mat4(scale * m_rotation);
+        model_to_world[3] = glm::vec4(inst.position, 1.0f);
+
+        // followed by the view chain
+        inst.xform = view_chain * model_to_world;
+
+        // rows of xform give clip x, y, z and w as functions of model coordinates
+        glm::mat4 rows = glm::transpose(inst.xform);
+        glm::vec4 const planes[6] = {
+            rows[0], w * rows[3] - rows[0], // 0 <= window x <= width
+            rows[1], h * rows[3] - rows[1], // 0 <= window y <= height
+            rows[3] + rows[2], rows[3] - rows[2], // -1 <= NDC z <= 1
+        };
+        // pad the radius so that rounding never culls a visible instance
+        float r = inst.model->radius * 1.0001f + 1e-4f;
+        inst.visible = !inst.model->tri.empty();
+        for (int k = 0; k < 6; ++k)
+        {
+            inst.frustum[k] = planes[k] / glm::length(glm::vec3(planes[k]));
+            inst.visible = inst.visible
+                && glm::dot(glm::vec3(inst.frustum[k]), inst.model->center) + inst.frustum[k].w + r > 0.0f;
+        }
+
+        size_t vtx_cnt = inst.model->pm.size();
+        if (inst.visible && inst.pd.size() != vtx_cnt)
+        {
+            inst.pd.resize(vtx_cnt);
+            inst.pw.resize(vtx_cnt);
+            inst.oc.resize(vtx_cnt);
+        }
+    }
+
+    VERTEX::for_each_batch([](Instance const& inst) { return inst.visible; }, transform_vertices);
+}
+
+/**
+@brief Sets the color of a pixel at the specified coordinates.
+This function sets the color of a pixel at the given (x, y) coordinates.
+It is called by the worker threads that rasterize tiles and therefore must not
+make any OpenGL calls.
+The position of the pixel in the PBO (Pixel Buffer Object) is calculated based on the width and the provided (x, y) coordinates.
+The color value is then assigned to the corresponding position in the PBO.
+
+@param x The x-coordinate of the pixel.
+@param y The y-coordinate of the pixel.
+@param clr The color to set for the pixel.
+*/
+void GLPbo::set_pixel(int x, int y, Color clr)
+{
+    int position = (GLPbo::width * y) + x;
+    ptr_to_pbo[position] = clr;
+    hiZBuffer[static_cast<size_t>(y / hiZBlockSize) * hiZBlocksX + x / hiZBlockSize].painted = true;
 }
 
 /**
@@ -698,893 +1943,915 @@ void GLPbo::render_linebresenham(GLint x0, GLint y0,
 }
 
 /**
-@brief Normalizes an angle in degrees to the range [0, 360).
-This function normalizes an angle in degrees to the range [0, 360) by applying modulo operation.
-If the input angle is positive, it is modulo divided by 360.
-If the input angle is negative, its absolute value is modulo divided by -360.
-The resulting normalized angle is returned.
-
-@param degrees The angle in degrees to be normalized.
-@return The normalized angle in the range [0, 360).
+@brief Clips a line segment to the pixels of the window.
+The segment is clipped with the Liang-Barsky algorithm against the rectangle
+[0, width - 1] x [0, height - 1], so that every pixel that
+GLPbo::render_linebresenham() sets for the clipped segment exists. Segments
+that lie inside the window are left untouched.
+
+@param p0 The first end point in window coordinates; moved if clipped.
+@param p1 The second end point in window coordinates; moved if clipped.
+@return False if the segment misses the window.
 */
-float normalizeDegrees(float degrees) {
-    if (degrees >= 0) {
-        degrees = static_cast<float>(fmod(degrees, 360));
+bool clip_line(glm::dvec2& p0, glm::dvec2& p1)
+{
+    glm::dvec2 d = p1 - p0;
+    glm::dvec2 const hi(GLPbo::width - 1, GLPbo::height - 1);
+    double t0 = 0.0, t1 = 1.0;
+    for (int axis = 0; axis < 2; ++axis)
+    {
+        // p0 + t * d is inside both p[axis] >= 0 and p[axis] <= hi[axis],
+        // i.e. t * den[k] <= num[k] for both k
+        double const num[2] = { p0[axis], hi[axis] - p0[axis] };
+        double const den[2] = { -d[axis], d[axis] };
+        for (int k = 0; k < 2; ++k)
+        {
+            if (den[k] == 0.0)
+            {
+                if (num[k] < 0.0)
+                {
+                    return false;
+                }
+                continue;
+            }
+            double t = num[k] / den[k];
+            if (den[k] < 0.0)
+            {
+                t0 = std::max(t0, t); // entering
+            }
+            else
+            {
+                t1 = std::min(t1, t); // leaving
+            }
+        }
     }
-    else {
-        degrees = static_cast<float>(fmod(degrees, -360));
+    if (t0 > t1)
+    {
+        return false;
     }
-    return degrees;
-}
-
-struct EdgeEqn {
-    double a{};
-    double b{};
-    double c{};
-
-    bool topLeft{};
-};
-
-/**
-@brief Computes the edge equation for a line segment defined by two points.
-This function computes the edge equation for a line segment defined by two points, p0 and p1.
-The edge equation is represented by the coefficients (a, b, c) in the equation ax + by + c = 0.
-The function assigns the computed coefficients to the provided EdgeEqn structure, E.
-
-@param p0 The first point of the line segment.
-@param p1 The second point of the line segment.
-@param E The EdgeEqn structure to store the computed coefficients.
-*/
-void computeEdgeEqn(glm::dvec3 const& p0, glm::dvec3 const& p1, EdgeEqn& E) {
-
-    E.a = p0.y - p1.y;
-    E.b = p1.x - p0.x;
-    E.c = p0.x * p1.y - p1.x * p0.y;
-
-    // Check for Left edge         // Check for Top Edge
-    E.topLeft = (E.a != 0.0) ? (E.a > 0.0 ? true : false) : (E.b < 0.0 ? true : false);
-
+    glm::dvec2 q0 = p0 + t0 * d;
+    if (t1 < 1.0)
+    {
+        p1 = p0 + t1 * d;
+    }
+    p0 = q0;
+    return true;
 }
 
 /**
-@brief Checks if a point is in the interior of an edge, considering the TopLeft tie breaker.
-This function determines if a point is in the interior of an edge, taking into account the TopLeft tie breaker.
-The function takes an evaluation value (eval), which indicates the result of evaluating the edge equation with the point coordinates.
-If the eval value is greater than 0, it means the point is on the interior of the edge.
-If the eval value is equal to 0 and the topLeft flag is true, indicating the edge passes the TopLeft tie breaker,
-the point is also considered in the interior.
-The function returns true if the point is in the interior, and false otherwise.
-
-@param eval The evaluation value of the edge equation with the point coordinates.
-@param p The coordinates of the point to be checked.
-@param topLeft The flag indicating if the edge passes the TopLeft tie breaker.
-@return True if the point is in the interior of the edge, false otherwise.
-*/
-bool PointInEdgeTopLeftOptimized(double const& eval, glm::dvec2 p, bool& topLeft) noexcept{
-    UNREFERENCED_PARAMETER(p);
-    // if eval is more than 0 means its on the interior of the line.
-    // also if, eval == 0 (meaning on the edge line itself) and if the line pass the TopLeft tie breaker, -
-    // it is considered in the interior as well and thus should be considered in the interior
-    return (eval > 0 || (eval == 0 && topLeft == true)) ? true : false;
-}
+@brief Normalizes an angle in degrees to the range [0, 360).
+This function normalizes an angle in degrees to the range [0, 360) by applying modulo operation.
+If the input angle is positive, it is modulo divided by 360.
+If the input angle is negative, its absolute value is modulo divided by -360.
+The resulting normalized angle is returned.
 
-/**
-@brief Checks if a point is inside a triangle, considering the TopLeft tie breaker for each edge.
-This function determines if a point is inside a triangle, taking into account the TopLeft tie breaker for each edge.
-The function takes three evaluation values (eval0, eval1, eval2), which indicate the results of evaluating the edge equations
-of the triangle's edges with the point coordinates.
-For each edge, the function calls the PointInEdgeTopLeftOptimized function, which considers the TopLeft tie breaker.
-If the point is inside all three edges (passes the TopLeft tie breaker for each edge), the function returns true.
-Otherwise, it returns false.
-
-@param eval0 The evaluation value of the first edge equation with the point coordinates.
-@param eval1 The evaluation value of the second edge equation with the point coordinates.
-@param eval2 The evaluation value of the third edge equation with the point coordinates.
-@param p The coordinates of the point to be checked.
-@param topLeft0 The flag indicating if the first edge passes the TopLeft tie breaker.
-@param topLeft1 The flag indicating if the second edge passes the TopLeft tie breaker.
-@param topLeft2 The flag indicating if the third edge passes the TopLeft tie breaker.
-@return True if the point is inside the triangle, false otherwise.
+@param degrees The angle in degrees to be normalized.
+@return The normalized angle in the range [0, 360).
 */
-bool PointInTriangleOptimized(double const& eval0, double const& eval1, double const& eval2, glm::dvec2 p, bool& topLeft0, bool& topLeft1, bool& topLeft2) {
-    if (PointInEdgeTopLeftOptimized(eval0, p, topLeft0) && PointInEdgeTopLeftOptimized(eval1, p, topLeft1) && PointInEdgeTopLeftOptimized(eval2, p, topLeft2)) {
-        return true;
+float normalizeDegrees(float degrees) {
+    if (degrees >= 0) {
+        degrees = static_cast<float>(fmod(degrees, 360));
     }
     else {
-        return false;
+        degrees = static_cast<float>(fmod(degrees, -360));
     }
+    return degrees;
 }
 
 /**
-@brief Calculates the evaluation value of an edge equation with the TopLeft tie breaker.
-This function calculates the evaluation value of an edge equation with the TopLeft tie breaker
-for a given random point. The edge equation is represented by the coefficients (a, b, c) in the equation ax + by + c = 0,
-stored in the provided EdgeEqn structure, E.
-The function computes the evaluation value by substituting the coordinates of the random point into the edge equation.
-
-@param E The EdgeEqn structure containing the coefficients of the edge equation.
-@param random_point The coordinates of the random point.
-@return The evaluation value of the edge equation with the TopLeft tie breaker.
+@brief Writes an 8-bit RGB image as a PNG file.
+The image data is stored in uncompressed deflate blocks, which keeps the
+encoder free of external dependencies at the cost of file size.
+
+@param os The binary stream to write to.
+@param rgb Pixel rows from top to bottom, 3 bytes per pixel.
+@param w The width of the image.
+@param h The height of the image.
 */
-double calculateEdgeEqn_TopLeft(EdgeEqn& E, glm::dvec3 random_point) {
-    // this is eval of the EdgeEqn
-    return (E.a * random_point.x + E.b * random_point.y + E.c);
-}
-
-/**
- * @brief Renders a faceted shading for a triangle defined by its vertices and corresponding normals.
- *
- * This function computes the faceted shading for a triangle specified by three vertices (p0, p1, p2)
- * and their corresponding vertex normals (m0, m1, m2). The faceted shading is computed based on the
- * provided light position (CORE10::light_pos) and a given reflectance value. The computed shading is
- * applied to the triangle and rendered into a buffer using barycentric interpolation.
- *
- * @param p0 The first vertex of the triangle.
- * @param p1 The second vertex of the triangle.
- * @param p2 The third vertex of the triangle.
- * @param m0 The normal vector at vertex p0.
- * @param m1 The normal vector at vertex p1.
- * @param m2 The normal vector at vertex p2.
- *
- * @return Always returns true, indicating that the rendering was successful.
- */
-bool GLPbo::render_faceted_shading(glm::dvec3 const& p0, glm::dvec3 const& p1, glm::dvec3 const& p2, glm::dvec3 const& m0, glm::dvec3 const& m1, glm::dvec3 const& m2) {
-    EdgeEqn e0, e1, e2;
-
-    // Edge equation of the 3 lines
-    computeEdgeEqn(p1, p2, e0);
-    computeEdgeEqn(p2, p0, e1);
-    computeEdgeEqn(p0, p1, e2);
-
-    double area_full_triangle = ((p1.x - p0.x) * (p2.y - p0.y) - (p2.x - p0.x) * (p1.y - p0.y));
-
-    // Bounding box of the triangle
-    GLdouble minX = floor(std::min({ p0.x, p1.x, p2.x }));
-    GLdouble maxX = ceil(std::max({ p0.x, p1.x, p2.x }));
-    GLdouble minY = floor(std::min({ p0.y, p1.y, p2.y }));
-    GLdouble maxY = ceil(std::max({ p0.y, p1.y, p2.y }));
-
-    double eVal0 = calculateEdgeEqn_TopLeft(e0, { minX + 0.5f, minY + 0.5f, 0 });
-    double eVal1 = calculateEdgeEqn_TopLeft(e1, { minX + 0.5f, minY + 0.5f, 0 });
-    double eVal2 = calculateEdgeEqn_TopLeft(e2, { minX + 0.5f, minY + 0.5f, 0 });
-
-    double barycentric_a = eVal0 / area_full_triangle;
-    double barycentric_b = eVal1 / area_full_triangle;
-    double barycentric_c = eVal2 / area_full_triangle;
-
-    double incrementX_a = e0.a / area_full_triangle;
-    double incrementX_b = e1.a / area_full_triangle;
-    double incrementX_c = e2.a / area_full_triangle;
-
-    double incrementY_a = e0.b / area_full_triangle;
-    double incrementY_b = e1.b / area_full_triangle;
-    double incrementY_c = e2.b / area_full_triangle;
-
-    double e0a = e0.a, e1a = e1.a, e2a = e2.a;
-    double e0b = e0.b, e1b = e1.b, e2b = e2.b;
-
-    int intMaxX = static_cast<int>(maxX);
-    int intMaxY = static_cast<int>(maxY);
-    int intMinX = static_cast<int>(minX);
-    int intMinY = static_cast<int>(minY);
-
-    glm::mat3 inverse_transform = glm::inverse(current_mdl_iterator->second.ModelTrans);
-
-    double Cx = (m0.x + m1.x + m2.x) * 0.333;
-    double Cy = (m0.y + m1.y + m2.y) * 0.333;
-    double Cz = (m0.z + m1.z + m2.z) * 0.333;
-
-    glm::dvec3 centroid = glm::dvec3(Cx, Cy, Cz);
-
-    glm::dvec3 AB = m1 - m0;
-    glm::dvec3 AC = m2 - m0;
-    glm::dvec3 outwardNormal = glm::normalize(glm::cross(AB, AC));
-
-    glm::dvec3 lightpos = CORE10::light_pos_rotated;
-    lightpos = inverse_transform * lightpos;
-    glm::dvec3 vectorToLight = lightpos - centroid;
-    glm::dvec3 normalisedvectorToLight = glm::normalize(vectorToLight);
-  
-    double dotProduct = glm::dot(outwardNormal, normalisedvectorToLight);
-   
-    glm::dvec3 reflectance{1.0,1.0,1.0};
-    glm::dvec3 incomingLight = glm::max(0.0, dotProduct) * reflectance * CORE10::intensity;
-    
-    GLubyte clr = static_cast<GLubyte>(incomingLight.x*255);
-    
-    for (int y = intMinY; y < intMaxY; ++y)
-    {
-        double HEVal0 = eVal0;
-        double HEVal1 = eVal1;
-        double HEVal2 = eVal2;
-
-        double HEa = barycentric_a;
-        double HEb = barycentric_b;
-        double HEc = barycentric_c;
-
-        for (int x = intMinX; x < intMaxX; ++x)
+void write_png(std::ostream& os, std::vector<unsigned char> const& rgb, GLsizei w, GLsizei h)
+{
+    static std::uint32_t const* crc_table = [] {
+        static std::uint32_t table[256];
+        for (std::uint32_t n = 0; n < 256; ++n)
         {
-            if ((y < 0 || y >= height) || (x < 0 || x >= width)) { continue; }
-            if (PointInTriangleOptimized(HEVal0, HEVal1, HEVal2, { x + 0.5, y + 0.5 }, e0.topLeft, e1.topLeft, e2.topLeft))
+            std::uint32_t c = n;
+            for (int k = 0; k < 8; ++k)
             {
-                double z = HEa * p0.z + HEb * p1.z + HEc * p2.z;
-                z = (z + 1) / 2;
-                int buffer_idx = y * GLPbo::width + x;
-                if (z < depthBuffer[buffer_idx])
-                {
-                    depthBuffer[buffer_idx] = z;
-                    set_pixel(x, y, { clr,clr,clr });
-                }
-                
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
             }
-            // plus 'a' is increment it horizontally aka increment x-axis
-            HEVal0 += e0a;
-            HEVal1 += e1a;
-            HEVal2 += e2a;
+            table[n] = c;
+        }
+        return table;
+    }();
 
-            HEa += incrementX_a;
-            HEb += incrementX_b;
-            HEc += incrementX_c;
+    auto put32 = [](std::vector<unsigned char>& v, std::uint32_t x)
+    {
+        v.insert(v.end(), { static_cast<unsigned char>(x >> 24), static_cast<unsigned char>(x >> 16),
+                            static_cast<unsigned char>(x >> 8), static_cast<unsigned char>(x) });
+    };
+    auto chunk = [&os, &put32](char const* type, std::vector<unsigned char> const& data)
+    {
+        std::vector<unsigned char> out;
+        put32(out, static_cast<std::uint32_t>(data.size()));
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), data.begin(), data.end());
+        std::uint32_t crc = 0xFFFFFFFFu;
+        for (size_t i = 4; i < out.size(); ++i)
+        {
+            crc = crc_table[(crc ^ out[i]) & 0xFF] ^ (crc >> 8);
         }
-        // plus 'b' is increment it vertically aka increment y-axis
-        eVal0 += e0b;
-        eVal1 += e1b;
-        eVal2 += e2b;
+        put32(out, crc ^ 0xFFFFFFFFu);
+        os.write(reinterpret_cast<char const*>(out.data()), out.size());
+    };
 
-        barycentric_a += incrementY_a;
-        barycentric_b += incrementY_b;
-        barycentric_c += incrementY_c;
+    // every scanline is preceded by filter type 0 (none)
+    size_t const stride = static_cast<size_t>(w) * 3;
+    std::vector<unsigned char> raw;
+    raw.reserve((stride + 1) * h);
+    for (GLsizei y = 0; y < h; ++y)
+    {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgb.begin() + y * stride, rgb.begin() + (y + 1) * stride);
     }
 
-    return true;
+    // zlib stream made of stored deflate blocks of at most 65535 bytes
+    std::vector<unsigned char> z{ 0x78, 0x01 };
+    for (size_t pos = 0; pos < raw.size() || pos == 0; )
+    {
+        size_t len = std::min<size_t>(raw.size() - pos, 65535);
+        bool last = pos + len == raw.size();
+        z.push_back(last ? 1 : 0);
+        z.insert(z.end(), { static_cast<unsigned char>(len), static_cast<unsigned char>(len >> 8),
+                            static_cast<unsigned char>(~len), static_cast<unsigned char>(~len >> 8) });
+        z.insert(z.end(), raw.begin() + pos, raw.begin() + pos + len);
+        pos += len;
+        if (last)
+        {
+            break;
+        }
+    }
+    std::uint32_t a = 1, b = 0;
+    for (unsigned char c : raw)
+    {
+        a = (a + c) % 65521;
+        b = (b + a) % 65521;
+    }
+    put32(z, (b << 16) | a);
+
+    std::vector<unsigned char> ihdr;
+    put32(ihdr, static_cast<std::uint32_t>(w));
+    put32(ihdr, static_cast<std::uint32_t>(h));
+    ihdr.insert(ihdr.end(), { 8, 2, 0, 0, 0 }); // 8-bit RGB, no interlace
+
+    static unsigned char const signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    os.write(reinterpret_cast<char const*>(signature), sizeof(signature));
+    chunk("IHDR", ihdr);
+    chunk("IDAT", z);
+    chunk("IEND", {});
 }
 
-/**
- * @brief Renders a shadow map for a triangle to be used in shadow mapping.
- *
- * This function computes a shadow map for a triangle specified by its three vertices (p0, p1, p2).
- * The shadow map is created by rendering the triangle from the light's perspective into a depth buffer.
- * The depth buffer is used later for shadow mapping to determine whether a point is in shadow or not.
- *
- * @param p0 The first vertex of the triangle.
- * @param p1 The second vertex of the triangle.
- * @param p2 The third vertex of the triangle.
- *
- * @return Always returns true, indicating that the shadow map rendering was successful.
- */
-bool GLPbo::render_shadow_map(glm::dvec3 const& p0, glm::dvec3 const& p1, glm::dvec3 const& p2) {
-
-    EdgeEqn e0, e1, e2;
-
-    // E1dge equation of the 3 lines0
-    computeEdgeEqn(p1, p2, e0);
-    computeEdgeEqn(p2, p0, e1);
-    computeEdgeEqn(p0, p1, e2);
-
-    double area_full_triangle = ((p1.x - p0.x) * (p2.y - p0.y) - (p2.x - p0.x) * (p1.y - p0.y));
+/*  _________________________________________________________________________ */
+/*  Rasterizer core shared by every shading mode.
+    Vertices are snapped to 28.4 fixed point and the three edge functions are
+    evaluated exactly in integers, so the top-left tie-breaking rule reduces to
+    a bias of 1 on edges that are neither top nor left edges. Coverage is
+    tested for a whole span of RASTER::lanes pixels per step with SSE2 (4 wide)
+    or AVX2 (8 wide) and the shading callback is only invoked for covered
+    pixels.
+*/
+namespace RASTER
+{
+    // 4 bits of sub-pixel precision (28.4 fixed point)
+    constexpr int sub_bits = 4;
+    constexpr std::int64_t sub_one = std::int64_t(1) << sub_bits;
+
+    // Inside a tile the edge functions are stepped in 32-bit integers. This
+    // cannot overflow because GLPbo::bin_triangles() clips every triangle to
+    // within GLPbo::guard_band pixels of the window origin ...
+
+    // Attributes of a triangle whose vertices have different clip w are
+    // interpolated with perspective correction, unless the correction moves
+    // them by less than affine_error pixels. The reciprocal needed by the
+    // correction is computed exactly at both ends of every span and
+    // interpolated linearly in between when its relative error is below
+    // span_error^2 / 4; otherwise it is computed for every pixel.
+    constexpr double affine_error = 0.125;
+    constexpr double span_error = 1.0 / 64.0;
+
+#if defined(__AVX2__)
+    constexpr int lanes = 8;
+    using vint = __m256i;
+    inline vint splat(std::int32_t v) { return _mm256_set1_epi32(v); }
+    inline vint ramp(std::int32_t step) { return _mm256_setr_epi32(0, step, 2 * step, 3 * step, 4 * step, 5 * step, 6 * step, 7 * step); }
+    inline vint add(vint a, vint b) { return _mm256_add_epi32(a, b); }
+    // bit k is set if lane k of all three edge values is non-negative
+    inline unsigned inside(vint e0, vint e1, vint e2) {
+        vint any = _mm256_or_si256(_mm256_or_si256(e0, e1), e2);
+        return ~static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(any))) & 0xFFu;
+    }
+#else
+    constexpr int lanes = 4;
+    using vint = __m128i;
+    inline vint splat(std::int32_t v) { return _mm_set1_epi32(v); }
+    inline vint ramp(std::int32_t step) { return _mm_setr_epi32(0, step, 2 * step, 3 * step); }
+    inline vint add(vint a, vint b) { return _mm_add_epi32(a, b); }
+    // bit k is set if lane k of all three edge values is non-negative
+    inline unsigned inside(vint e0, vint e1, vint e2) {
+        vint any = _mm_or_si128(_mm_or_si128(e0, e1), e2);
+        return ~static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(any))) & 0xFu;
+    }
+#endif
+
+    struct Setup {
+        // edge function i (opposite vertex i) at the center of pixel (x, y)
+        // is a[i] * x + b[i] * y + c[i]; c already contains the top-left bias
+        std::int64_t a[3], b[3], c[3];
+        // barycentric coordinate i at pixel (x, y) is
+        // l_dx[i] * x + l_dy[i] * y + l_c[i]
+        double l_dx[3], l_dy[3], l_c[3];
+        // perspective-correct barycentric coordinate i is
+        // l[i] * q[i] / (l . q) where q are the reciprocal clip w of the
+        // vertices and l . q is q_dx * x + q_dy * y + q_c
+        bool perspective; // false if the correction is negligible
+        bool span_lerp;   // 1 / (l . q) is interpolated across spans
+        double q[3], q_dx, q_dy, q_c;
+        double z[3];                // vertex depths mapped to [0, 1]
+        float zmin, zmax;           // depth range of the triangle
+        int minX, minY, maxX, maxY; // pixel bounding box [min, max)
+    };
 
-    // Bounding box of the triangle
-    GLdouble minX = floor(std::min({ p0.x, p1.x, p2.x }));
-    GLdouble maxX = ceil(std::max({ p0.x, p1.x, p2.x }));
-    GLdouble minY = floor(std::min({ p0.y, p1.y, p2.y }));
-    GLdouble maxY = ceil(std::max({ p0.y, p1.y, p2.y }));
+    /**
+    @brief Computes fixed-point edge functions and the bounding box of a triangle.
+    Window coordinates are snapped to 28.4 fixed point. Edges that are neither
+    top nor left edges get a bias of 1 so that a pixel is inside the triangle
+    exactly when all three biased edge values are non-negative.
+
+    @param p0 The first vertex in window coordinates.
+    @param p1 The second vertex in window coordinates.
+    @param p2 The third vertex in window coordinates.
+    The bounding box is clamped to the viewport, so later stages never visit
+    pixels outside of the window. All vertices must lie inside the guard band.
+    @param q The reciprocal clip w of the vertices.
+
+    @param s The setup to fill in.
+    @return False if the snapped triangle is back-facing or degenerate, or if
+    it does not overlap the viewport; true otherwise.
+    */
+    bool setup_triangle(glm::dvec3 const& p0, glm::dvec3 const& p1, glm::dvec3 const& p2, double const (&q)[3], Setup& s)
+    {
+        glm::dvec3 const* p[3] = { &p0, &p1, &p2 };
+        std::int64_t X[3], Y[3];
+        for (int i = 0; i < 3; ++i)
+        {
+            X[i] = std::llround(p[i]->x * sub_one);
+            Y[i] = std::llround(p[i]->y * sub_one);
+        }
 
-    double eVal0 = calculateEdgeEqn_TopLeft(e0, { minX + 0.5f, minY + 0.5f, 0 });
-    double eVal1 = calculateEdgeEqn_TopLeft(e1, { minX + 0.5f, minY + 0.5f, 0 });
-    double eVal2 = calculateEdgeEqn_TopLeft(e2, { minX + 0.5f, minY + 0.5f, 0 });
+        std::int64_t area = (X[1] - X[0]) * (Y[2] - Y[0]) - (X[2] - X[0]) * (Y[1] - Y[0]);
+        if (area <= 0)
+        {
+            return false;
+        }
+        double inv_area = 1.0 / static_cast<double>(area);
 
-    double barycentric_a = eVal0 / area_full_triangle;
-    double barycentric_b = eVal1 / area_full_triangle;
-    double barycentric_c = eVal2 / area_full_triangle;
+        for (int i = 0; i < 3; ++i)
+        {
+            int j = (i + 1) % 3, k = (i + 2) % 3;
+            std::int64_t A = Y[j] - Y[k];
+            std::int64_t B = X[k] - X[j];
+            // Check for Left edge         // Check for Top Edge
+            bool topLeft = (A != 0) ? (A > 0) : (B < 0);
+            std::int64_t c = A * (sub_one / 2) + B * (sub_one / 2) + X[j] * Y[k] - X[k] * Y[j];
+
+            s.a[i] = A * sub_one;
+            s.b[i] = B * sub_one;
+            s.c[i] = c - (topLeft ? 0 : 1);
+
+            s.l_dx[i] = static_cast<double>(s.a[i]) * inv_area;
+            s.l_dy[i] = static_cast<double>(s.b[i]) * inv_area;
+            s.l_c[i] = static_cast<double>(c) * inv_area;
+        }
 
-    double incrementX_a = e0.a / area_full_triangle;
-    double incrementX_b = e1.a / area_full_triangle;
-    double incrementX_c = e2.a / area_full_triangle;
+        s.minX = static_cast<int>(std::min({ X[0], X[1], X[2] }) >> sub_bits);
+        s.minY = static_cast<int>(std::min({ Y[0], Y[1], Y[2] }) >> sub_bits);
+        s.maxX = static_cast<int>(std::max({ X[0], X[1], X[2] }) >> sub_bits) + 1;
+        s.maxY = static_cast<int>(std::max({ Y[0], Y[1], Y[2] }) >> sub_bits) + 1;
+
+        // the affine barycentric coordinates are off by at most
+        // (qmax - qmin) / qmin, i.e. that fraction of the triangle's extent
+        double qmin = std::min({ q[0], q[1], q[2] }), qmax = std::max({ q[0], q[1], q[2] });
+        double extent = std::max(s.maxX - s.minX, s.maxY - s.minY);
+        s.perspective = (qmax - qmin) * extent > affine_error * qmin;
+        if (s.perspective)
+        {
+            s.q_dx = s.q_dy = s.q_c = 0.0;
+            for (int i = 0; i < 3; ++i)
+            {
+                s.q[i] = q[i];
+                s.q_dx += q[i] * s.l_dx[i];
+                s.q_dy += q[i] * s.l_dy[i];
+                s.q_c += q[i] * s.l_c[i];
+            }
+            // l . q is at least qmin inside the triangle
+            s.span_lerp = std::abs(s.q_dx) * (lanes - 1) <= span_error * qmin;
+        }
 
-    double incrementY_a = e0.b / area_full_triangle;
-    double incrementY_b = e1.b / area_full_triangle;
-    double incrementY_c = e2.b / area_full_triangle;
+        for (int i = 0; i < 3; ++i)
+        {
+            s.z[i] = (p[i]->z + 1) / 2;
+        }
+        s.zmin = static_cast<float>(std::min({ s.z[0], s.z[1], s.z[2] }));
+        s.zmax = static_cast<float>(std::max({ s.z[0], s.z[1], s.z[2] }));
+
+        s.minX = std::max(s.minX, 0);
+        s.minY = std::max(s.minY, 0);
+        s.maxX = std::min(s.maxX, static_cast<int>(GLPbo::width));
+        s.maxY = std::min(s.maxY, static_cast<int>(GLPbo::height));
+        return s.minX < s.maxX && s.minY < s.maxY;
+    }
 
+    static_assert(GLPbo::tile_size % hiZBlockSize == 0 && hiZBlockSize % lanes == 0,
+        "Hi-Z blocks must tile the screen tiles and hold whole spans");
 
-    double e0a = e0.a, e1a = e1.a, e2a = e2.a;
-    double e0b = e0.b, e1b = e1.b, e2b = e2.b;
+    /**
+    @brief Recomputes the depth range of a dirty Hi-Z block.
 
-    int intMaxX = static_cast<int>(maxX);
-    int intMaxY = static_cast<int>(maxY);
-    int intMinX = static_cast<int>(minX);
-    int intMinY = static_cast<int>(minY);
+    @param block The block to update.
+    @param bx The x coordinate of the block's left column.
+    @param by The y coordinate of the block's bottom row.
+    */
+    void update_hiz(HiZBlock& block, int bx, int by)
+    {
+        int x1 = std::min(bx + hiZBlockSize, static_cast<int>(GLPbo::width));
+        int y1 = std::min(by + hiZBlockSize, static_cast<int>(GLPbo::height));
+        float zmin = 1.0f, zmax = 0.0f;
+        for (int y = by; y < y1; ++y)
+        {
+            float const* row = depthBuffer + static_cast<size_t>(y) * GLPbo::width;
+            for (int x = bx; x < x1; ++x)
+            {
+                zmin = std::min(zmin, row[x]);
+                zmax = std::max(zmax, row[x]);
+            }
+        }
+        block.zmin = zmin;
+        block.zmax = zmax;
+        block.dirty = false;
+    }
 
+    /**
+    @brief Depth tests and shades every pixel of a tile covered by a triangle.
+    The edge values at the first span of the clipped bounding box are computed
+    in 64 bits. An edge that is positive over the whole box is dropped, and
+    the triangle is rejected if any edge is negative over the whole box; the
+    remaining edges are small enough to be stepped in 32-bit SIMD lanes.
+    Pixels are visited block by block of the Hi-Z buffer: blocks that the
+    triangle cannot be in front of are skipped after counting their covered
+    pixels, and blocks that the triangle is entirely in front of skip the
+    per-pixel depth comparison.
+
+    @param s The triangle setup computed by setup_triangle().
+    @param tile The tile that owns the pixels.
+    @param shade Callback invoked as shade(l0, l1, l2, z) for every covered
+    pixel that passes the depth test, where l0, l1 and l2 are the barycentric
+    coordinates of its center - perspective-correct if Setup::perspective is
+    set - and z its depth, which is affine in window coordinates. It returns
+    the pixel's color.
+    @param rejected Incremented by the number of covered pixels rejected by
+    the Hi-Z buffer.
+    */
+    template <typename Shade>
+    void traverse(Setup const& s, GLPbo::Tile const& tile, Shade&& shade, std::uint64_t& rejected)
+    {
+        int x0 = std::max(s.minX, tile.x0), x1 = std::min(s.maxX, tile.x1);
+        int y0 = std::max(s.minY, tile.y0), y1 = std::min(s.maxY, tile.y1);
+        if (x0 >= x1 || y0 >= y1)
+        {
+            return;
+        }
+        // spans are aligned to Hi-Z blocks so they never leave a block's
+        // (and therefore the tile's) footprint
+        int xs = x0 & ~(hiZBlockSize - 1);
 
-    for (int y = intMinY; y < intMaxY; ++y) {
-        double HEVal0 = eVal0;
-        double HEVal1 = eVal1;
-        double HEVal2 = eVal2;
+        std::int32_t row[3], dx[3], dy[3];
+        for (int i = 0; i < 3; ++i)
+        {
+            std::int64_t e = s.a[i] * xs + s.b[i] * y0 + s.c[i];
+            std::int64_t ex = s.a[i] * (x1 - 1 - xs), ey = s.b[i] * (y1 - 1 - y0);
+            if (e + std::max<std::int64_t>(ex, 0) + std::max<std::int64_t>(ey, 0) < 0)
+            {
+                return; // every pixel is outside this edge
+            }
+            if (e + std::min<std::int64_t>(ex, 0) + std::min<std::int64_t>(ey, 0) >= 0)
+            {
+                row[i] = dx[i] = dy[i] = 0; // every pixel is inside this edge
+                continue;
+            }
+            row[i] = static_cast<std::int32_t>(e);
+            dx[i] = static_cast<std::int32_t>(s.a[i]);
+            dy[i] = static_cast<std::int32_t>(s.b[i]);
+        }
 
-        double HEa = barycentric_a;
-        double HEb = barycentric_b;
-        double HEc = barycentric_c;
+        vint ramp0 = ramp(dx[0]), ramp1 = ramp(dx[1]), ramp2 = ramp(dx[2]);
+        vint step0 = splat(dx[0] * lanes), step1 = splat(dx[1] * lanes), step2 = splat(dx[2] * lanes);
+        unsigned const full = (1u << lanes) - 1u;
 
-        for (int x = intMinX; x < intMaxX; ++x)
+        for (int by = y0 & ~(hiZBlockSize - 1); by < y1; by += hiZBlockSize)
         {
-            if ((y < 0 || y >= height) || (x < 0 || x >= width)) { continue; }
-            if (PointInTriangleOptimized(HEVal0, HEVal1, HEVal2, { x + 0.5, y + 0.5 }, e0.topLeft, e1.topLeft, e2.topLeft))
+            int ry0 = std::max(by, y0), ry1 = std::min(by + hiZBlockSize, y1);
+            for (int bx = xs; bx < x1; bx += hiZBlockSize)
             {
-                double z = HEa * p0.z + HEb * p1.z + HEc * p2.z;
-                z = (z + 1) / 2;
-                int buffer_idx = y * GLPbo::width + x;
-                if (z <= depthBuffer[buffer_idx])
+                HiZBlock& block = hiZBuffer[static_cast<size_t>(by / hiZBlockSize) * hiZBlocksX + bx / hiZBlockSize];
+                if (block.dirty)
                 {
-                    depthBuffer[buffer_idx] = z;
-                    set_pixel(x, y, { static_cast<GLubyte>(z * 255.0),static_cast<GLubyte>(z * 255.0),static_cast<GLubyte>(z * 255.0) });
+                    update_hiz(block, bx, by);
                 }
-            }
-            HEVal0 += e0a;
-            HEVal1 += e1a;
-            HEVal2 += e2a;
+                bool const reject = s.zmin >= block.zmax;
+                bool const accept = s.zmax < block.zmin;
+                bool written = false;
+                if (!reject)
+                {
+                    prepare_block(block, bx, by);
+                }
+                int sx1 = std::min(bx + hiZBlockSize, x1);
 
-            HEa += incrementX_a;
-            HEb += incrementX_b;
-            HEc += incrementX_c;
+                for (int y = ry0; y < ry1; ++y)
+                {
+                    std::int32_t ox = bx - xs, oy = y - y0;
+                    vint e0 = add(splat(row[0] + dx[0] * ox + dy[0] * oy), ramp0);
+                    vint e1 = add(splat(row[1] + dx[1] * ox + dy[1] * oy), ramp1);
+                    vint e2 = add(splat(row[2] + dx[2] * ox + dy[2] * oy), ramp2);
+
+                    for (int x = bx; x < sx1; x += lanes)
+                    {
+                        unsigned mask = inside(e0, e1, e2);
+                        e0 = add(e0, step0);
+                        e1 = add(e1, step1);
+                        e2 = add(e2, step2);
+                        if (x < x0)
+                        {
+                            mask &= full << (x0 - x);
+                        }
+                        if (x + lanes > x1)
+                        {
+                            mask &= full >> (x + lanes - x1);
+                        }
+                        if (reject)
+                        {
+                            rejected += std::popcount(mask);
+                            continue;
+                        }
+                        // reciprocal of l . q at the first pixel of the span
+                        // and its step to the next pixel
+                        double r0 = 0.0, r_dx = 0.0;
+                        if (s.perspective && s.span_lerp && mask)
+                        {
+                            double d0 = s.q_dx * x + s.q_dy * y + s.q_c;
+                            r0 = 1.0 / d0;
+                            r_dx = (1.0 / (d0 + s.q_dx * (lanes - 1)) - r0) / (lanes - 1);
+                        }
+                        while (mask)
+                        {
+                            int px = x + std::countr_zero(mask);
+                            mask &= mask - 1;
+                            double l1 = s.l_dx[1] * px + s.l_dy[1] * y + s.l_c[1];
+                            double l2 = s.l_dx[2] * px + s.l_dy[2] * y + s.l_c[2];
+                            double l0 = 1.0 - l1 - l2;
+                            double z = l0 * s.z[0] + l1 * s.z[1] + l2 * s.z[2];
+                            float depth = static_cast<float>(z);
+                            int buffer_idx = y * GLPbo::width + px;
+                            if (accept || depth < depthBuffer[buffer_idx])
+                            {
+                                depthBuffer[buffer_idx] = depth;
+                                if (s.perspective)
+                                {
+                                    double r = s.span_lerp ? r0 + r_dx * (px - x)
+                                        : 1.0 / (s.q_dx * px + s.q_dy * y + s.q_c);
+                                    l1 *= s.q[1] * r;
+                                    l2 *= s.q[2] * r;
+                                    l0 = 1.0 - l1 - l2;
+                                }
+                                GLPbo::ptr_to_pbo[buffer_idx] = shade(l0, l1, l2, z);
+                                written = true;
+                            }
+                        }
+                    }
+                }
+                if (written)
+                {
+                    block.dirty = true;
+                    block.painted = true;
+                }
+            }
         }
-        eVal0 += e0b;
-        eVal1 += e1b;
-        eVal2 += e2b;
+    }
+}
 
-        barycentric_a += incrementY_a;
-        barycentric_b += incrementY_b;
-        barycentric_c += incrementY_c;
+/*  _________________________________________________________________________ */
+/*  Fragment shaders used by GLPbo::draw_tile().
+    Every shading mode is a policy type with the following members:
+    - uses_diffuse, uses_texcoord: constexpr flags that tell draw_tile()
+      which vertex attributes to fetch into Triangle
+    - a constructor taking the model, called once per tile; lighting that
+      is shared by all triangles of the frame is set up by
+      GLPbo::setup_lighting() before any tile is drawn
+    - begin(t): called once per triangle that survives setup
+    - shade(t, l0, l1, l2, z): called for every fragment that passes the
+      depth test; returns the fragment's color
+    Since draw_tile() is instantiated for each policy, every mode gets its own
+    inner loop with the shader inlined and no per-fragment branching on the
+    mode. Adding a shading mode only requires another policy type.
+*/
+namespace SHADER
+{
+    // vertex attributes of the triangle being rasterized
+    struct Triangle {
+        GLuint id;       // offset into Model::tri of the (source) triangle
+        glm::dvec3 p[3]; // window coordinates
+        double q[3];     // reciprocal clip w
+        double d[3];     // per-vertex diffuse terms
+        glm::dvec2 t[3]; // texture coordinates
+    };
 
+    /**
+    @brief Computes the diffuse light reflected by a flat triangle.
+    The triangle's cached face normal is lit from its cached centroid.
+    */
+    glm::dvec3 facet_light(GLPbo::Instance const& inst, GLuint id)
+    {
+        GLPbo::Model const& model = *inst.model;
+        glm::dvec3 outwardNormal = model.fn[id / 3];
+        glm::dvec3 normalisedvectorToLight = glm::normalize(inst.light - glm::dvec3(model.fc[id / 3]));
+        double dotProduct = glm::dot(outwardNormal, normalisedvectorToLight);
+        return glm::max(0.0, dotProduct) * CORE10::intensity;
     }
-    return true;
-}
 
-/**
- * @brief Renders smooth shading for a triangle using Phong shading model.
- *
- * This function computes the smooth shading for a triangle specified by its three vertices (p0, p1, p2)
- * and their corresponding vertex normals (n0, n1, n2). The smooth shading is computed based on the
- * provided light position (CORE10::light_pos) and intensity (CORE10::intensity). The Phong shading model
- * is used to calculate the intensity of the triangle at each pixel, taking into account the normal vectors
- * and light source position.
- *
- * @param p0 The first vertex of the triangle.
- * @param p1 The second vertex of the triangle.
- * @param p2 The third vertex of the triangle.
- * @param m0 The corresponding position of the first vertex in model space.
- * @param m1 The corresponding position of the second vertex in model space.
- * @param m2 The corresponding position of the third vertex in model space.
- * @param n0 The normal vector at vertex p0.
- * @param n1 The normal vector at vertex p1.
- * @param n2 The normal vector at vertex p2.
- *
- * @return Always returns true, indicating that the rendering of smooth shading was successful.
- */
-bool GLPbo::render_smooth_shading(glm::dvec3 const& p0, glm::dvec3 const& p1, glm::dvec3 const& p2, glm::vec3 const& m0, glm::vec3 const& m1, glm::vec3 const& m2, 
-    glm::dvec3 const& n0, glm::dvec3 const& n1, glm::dvec3 const& n2) {
- 
-    //pm0 to lightsource pos
-    glm::dvec3 lightsource = CORE10::light_pos_rotated;
-    glm::dvec3 pm0 = glm::inverse(current_mdl_iterator->second.ModelTrans) * lightsource - m0;
-    glm::dvec3 pm1 = glm::inverse(current_mdl_iterator->second.ModelTrans) * lightsource - m1;
-    glm::dvec3 pm2 = glm::inverse(current_mdl_iterator->second.ModelTrans) * lightsource - m2;
-    pm0 = glm::normalize(pm0);
-    pm1 = glm::normalize(pm1);
-    pm2 = glm::normalize(pm2);
-    glm::dvec3 intensity = CORE10::intensity;
-    glm::dvec3 c0 = intensity * glm::max(0.0, glm::dot(n0, pm0));
-    glm::dvec3 c1 = intensity * glm::max(0.0, glm::dot(n1, pm1));
-    glm::dvec3 c2 = intensity * glm::max(0.0, glm::dot(n2, pm2));
-
-    EdgeEqn e0, e1, e2;
-
-    // E1dge equation of the 3 lines0
-    computeEdgeEqn(p1, p2, e0);
-    computeEdgeEqn(p2, p0, e1);
-    computeEdgeEqn(p0, p1, e2);
-
-    double area_full_triangle = ((p1.x - p0.x) * (p2.y - p0.y) - (p2.x - p0.x) * (p1.y - p0.y));
-
-    // Bounding box of the triangle
-    GLdouble minX = floor(std::min({ p0.x, p1.x, p2.x }));
-    GLdouble maxX = ceil(std::max({ p0.x, p1.x, p2.x }));
-    GLdouble minY = floor(std::min({ p0.y, p1.y, p2.y }));
-    GLdouble maxY = ceil(std::max({ p0.y, p1.y, p2.y }));
-
-    double eVal0 = calculateEdgeEqn_TopLeft(e0, { minX + 0.5f, minY + 0.5f, 0 });
-    double eVal1 = calculateEdgeEqn_TopLeft(e1, { minX + 0.5f, minY + 0.5f, 0 });
-    double eVal2 = calculateEdgeEqn_TopLeft(e2, { minX + 0.5f, minY + 0.5f, 0 });
-
-    double barycentric_a = eVal0 / area_full_triangle;
-    double barycentric_b = eVal1 / area_full_triangle;
-    double barycentric_c = eVal2 / area_full_triangle;
-
-    double incrementX_a = e0.a / area_full_triangle;
-    double incrementX_b = e1.a / area_full_triangle;
-    double incrementX_c = e2.a / area_full_triangle;
-
-    double incrementY_a = e0.b / area_full_triangle;
-    double incrementY_b = e1.b / area_full_triangle;
-    double incrementY_c = e2.b / area_full_triangle;
-
-
-    double e0a = e0.a, e1a = e1.a, e2a = e2.a;
-    double e0b = e0.b, e1b = e1.b, e2b = e2.b;
-
-    int intMaxX = static_cast<int>(maxX);
-    int intMaxY = static_cast<int>(maxY);
-    int intMinX = static_cast<int>(minX);
-    int intMinY = static_cast<int>(minY);
-
-
-    for (int y = intMinY; y < intMaxY; ++y) {
-        double HEVal0 = eVal0;
-        double HEVal1 = eVal1;
-        double HEVal2 = eVal2;
-
-        double HEa = barycentric_a;
-        double HEb = barycentric_b;
-        double HEc = barycentric_c;
-
-        for (int x = intMinX; x < intMaxX; ++x)
-        {
-            if ((y < 0 || y >= height) || (x < 0 || x >= width)) { continue; }
-            if (PointInTriangleOptimized(HEVal0, HEVal1, HEVal2, { x + 0.5, y + 0.5 }, e0.topLeft, e1.topLeft, e2.topLeft))
+    /**
+    @brief Level of detail of a texture across a triangle.
+    When the vertices share one clip w - always the case for the
+    orthographic projection - texture coordinates are an affine function of
+    window x and y, so their derivatives and the level of detail are
+    constant and computed once per triangle.
+    With perspective, the texture coordinates u = N / D are the quotient of
+    the affine functions N = sum(l_i q_i t_i) and D = sum(l_i q_i) of the
+    affine barycentric coordinates l_i, so du/dx = (dN/dx - u dD/dx) / D and
+    likewise for y. The gradients of N and D are set up once per triangle,
+    and the derivatives are evaluated at every fragment from its perspective
+    correct coordinates, where D = 1 / sum(l_i w_i). These are the exact
+    derivatives that a 2 x 2 quad approximates by differences, so every
+    fragment gets the level of detail of its own footprint instead of the
+    triangle's average, which blurred the parts of large triangles near the
+    eye and aliased the parts far from it.
+    */
+    struct TextureLod {
+        float lod{};           // level of detail of affine triangles
+        bool perspective{};    // vertices have different clip w
+        double w[3]{};         // clip w of the vertices
+        glm::dvec2 n_dx, n_dy; // gradients of N
+        double d_dx{}, d_dy{}; // gradients of D
+
+        void begin(Triangle const& t, GLTexture const& texture)
+        {
+            glm::dvec2 e1 = glm::dvec2(t.p[1] - t.p[0]), e2 = glm::dvec2(t.p[2] - t.p[0]);
+            double det = e1.x * e2.y - e2.x * e1.y;
+            perspective = false;
+            lod = 0.0f;
+            if (det == 0.0)
             {
-                double z = HEa * p0.z + HEb * p1.z + HEc * p2.z;
-                z = (z + 1) / 2;
-                int buffer_idx = y * GLPbo::width + x;
-               
-                if (z < depthBuffer[buffer_idx])
-                {
-                glm::dvec3 clr = HEa * c0 + HEb * c1 + HEc * c2;
-                depthBuffer[buffer_idx] = z;
-                set_pixel(x, y, { static_cast<GLubyte>(clr.x*255),static_cast<GLubyte>(clr.y*255),static_cast<GLubyte>(clr.z*255) });
-                }
+                return;
+            }
+            // gradients of the affine barycentric coordinates
+            glm::dvec2 g[3];
+            g[1] = glm::dvec2(e2.y, -e2.x) / det;
+            g[2] = glm::dvec2(-e1.y, e1.x) / det;
+            g[0] = -g[1] - g[2];
+            perspective = t.q[0] != t.q[1] || t.q[0] != t.q[2];
+            if (!perspective)
+            {
+                glm::dvec2 d1 = t.t[1] - t.t[0], d2 = t.t[2] - t.t[0];
+                lod = texture.lod(glm::vec2(g[1].x * d1 + g[2].x * d2), glm::vec2(g[1].y * d1 + g[2].y * d2));
+                return;
+            }
+            n_dx = n_dy = glm::dvec2(0.0);
+            d_dx = d_dy = 0.0;
+            for (int i = 0; i < 3; ++i)
+            {
+                w[i] = 1.0 / t.q[i];
+                n_dx += g[i].x * t.q[i] * t.t[i];
+                n_dy += g[i].y * t.q[i] * t.t[i];
+                d_dx += g[i].x * t.q[i];
+                d_dy += g[i].y * t.q[i];
             }
-            HEVal0 += e0a;
-            HEVal1 += e1a;
-            HEVal2 += e2a;
-
-            HEa += incrementX_a;
-            HEb += incrementX_b;
-            HEc += incrementX_c;
         }
-        eVal0 += e0b;
-        eVal1 += e1b;
-        eVal2 += e2b;
-
-        barycentric_a += incrementY_a;
-        barycentric_b += incrementY_b;
-        barycentric_c += incrementY_c;
 
-    }
-    return true;
-}
-
-/**
- * @brief Sets up a texture object using data from a binary file.
- *
- * This function reads texture data from a binary file specified by the given `pathname`
- * and sets up a texture object (texobj) with the loaded data. The texture data in the file
- * is assumed to have a width and height of 256 texels and use a 32-bit RGBA texel format.
- *
- * @param pathname The path to the binary file containing texture data.
- */
-void GLPbo::setup_texobj(std::string pathname) {
+        // level of detail at the fragment with perspective correct
+        // barycentric coordinates l0, l1, l2 and texture coordinates uv
+        float at(GLTexture const& texture, double l0, double l1, double l2, glm::dvec2 const& uv) const
+        {
+            if (!perspective)
+            {
+                return lod;
+            }
+            double d = 1.0 / (l0 * w[0] + l1 * w[1] + l2 * w[2]);
+            return texture.lod(glm::vec2((n_dx - uv * d_dx) / d), glm::vec2((n_dy - uv * d_dy) / d));
+        }
+    };
 
-    std::string file = "../images/" + pathname + ".tex";
-    std::ifstream ifs{ file, std::ios::binary };
-    if (!ifs) {
-        std::cout << "ERROR: Unable to open scene file: "
-            << pathname << "\n";
-        exit(EXIT_FAILURE);
+    /**
+    @brief Returns the filtered texture color at texture coordinates tx.
+    Texel channels are in [0, 255].
+    */
+    inline glm::vec3 sample_texture(GLTexture const& texture, glm::dvec2 const& tx, float lod)
+    {
+        return texture.sample(glm::vec2(tx), lod);
     }
-    //ifs.seekg(0, std::ios::end);
-    ifs.seekg(0, std::ios::beg);
-    // remember all our images have width and height of 256 texels and
-    // use 32-bit RGBA texel format
-    //GLuint width, height, bytes_per_texel;
-    ifs.read(reinterpret_cast<char*>(&textureWidth), sizeof(int));
-    ifs.read(reinterpret_cast<char*>(&textureHeight), sizeof(int));
-    ifs.read(reinterpret_cast<char*>(&bytes_per_texel), sizeof(int));
 
-    if (!ifs) {
-        std::cout << "ERROR: Failed to read file: "
-            << pathname << "\n";
-        exit(EXIT_FAILURE);
+    // attribute at barycentric weights w of the attributes a of a triangle
+    template <typename T>
+    inline T interpolate(glm::dvec3 const& w, T const (&a)[3])
+    {
+        return w.x * a[0] + w.y * a[1] + w.z * a[2];
     }
 
-    for (GLuint i = 0; i < textureWidth * textureHeight * bytes_per_texel; ++i)
+    // interpolated texture coordinates of a fragment
+    inline glm::dvec2 texcoord(Triangle const& t, double l0, double l1, double l2)
     {
-        unsigned char r{}, g{}, b{};
-        ifs.read(reinterpret_cast<char*>(&r), 1);
-        ifs.read(reinterpret_cast<char*>(&g), 1);
-        ifs.read(reinterpret_cast<char*>(&b), 1);
-
-        textureArray.push_back(glm::vec3(r, g, b));
+        return l0 * t.t[0] + l1 * t.t[1] + l2 * t.t[2];
     }
-    ifs.close();
 
-}
+    // depth buffer visualized as gray levels
+    struct DepthBuffer {
+        static constexpr bool uses_diffuse = false;
+        static constexpr bool uses_texcoord = false;
 
-/**
- * @brief Renders a texture map onto a triangle using barycentric interpolation.
- *
- * This function renders a texture map onto a triangle specified by its three vertices (p0, p1, p2) and
- * their corresponding texture coordinates (tx0, tx1, tx2). The texture map is applied to the triangle
- * using barycentric interpolation to calculate the texture position for each pixel inside the triangle.
- * The texture data is retrieved from a textureArray, and the depth buffer is used to ensure correct depth
- * testing and visibility of the textured pixels.
- *
- * @param p0 The first vertex of the triangle.
- * @param p1 The second vertex of the triangle.
- * @param p2 The third vertex of the triangle.
- * @param tx0 The texture coordinates at vertex p0.
- * @param tx1 The texture coordinates at vertex p1.
- * @param tx2 The texture coordinates at vertex p2.
- *
- * @return Always returns true, indicating that the rendering of the textured triangle was successful.
- */
-bool GLPbo::render_texture_map(glm::dvec3 const& p0, glm::dvec3 const& p1, glm::dvec3 const& p2,
-    glm::dvec2 const& tx0, glm::dvec2 const& tx1, glm::dvec2 const& tx2)
-{
-    EdgeEqn e0, e1, e2;
-    // Edge equation of the 3 lines0
-    computeEdgeEqn(p1, p2, e0);
-    computeEdgeEqn(p2, p0, e1);
-    computeEdgeEqn(p0, p1, e2);
+        explicit DepthBuffer(GLPbo::Instance const&) {}
+        void begin(Triangle const&) {}
+        GLPbo::Color shade(Triangle const&, double, double, double, double z) const {
+            GLubyte g = static_cast<GLubyte>(z * 255.0);
+            return { g, g, g };
+        }
+    };
 
-    double area_full_triangle = ((p1.x - p0.x) * (p2.y - p0.y) - (p2.x - p0.x) * (p1.y - p0.y));
+    // one diffuse gray level per triangle
+    struct Faceted {
+        static constexpr bool uses_diffuse = false;
+        static constexpr bool uses_texcoord = false;
 
-    // Bounding box of the triangle
-    double minX = floor(std::min({ p0.x, p1.x, p2.x }));
-    double maxX = ceil(std::max({ p0.x, p1.x, p2.x }));
-    double minY = floor(std::min({ p0.y, p1.y, p2.y }));
-    double maxY = ceil(std::max({ p0.y, p1.y, p2.y }));
+        GLPbo::Instance const& inst;
+        GLubyte clr{};
 
-    double eval0 = calculateEdgeEqn_TopLeft(e0, { minX + 0.5, minY + 0.5, 0 });
-    double eval1 = calculateEdgeEqn_TopLeft(e1, { minX + 0.5, minY + 0.5, 0 });
-    double eval2 = calculateEdgeEqn_TopLeft(e2, { minX + 0.5, minY + 0.5, 0 });
-   
+        explicit Faceted(GLPbo::Instance const& i) : inst{ i } {}
+        void begin(Triangle const& t) {
+            clr = static_cast<GLubyte>(facet_light(inst, t.id).x * 255);
+        }
+        GLPbo::Color shade(Triangle const&, double, double, double, double) const {
+            return { clr, clr, clr };
+        }
+    };
 
+    // diffuse light computed per vertex and interpolated across the triangle
+    struct Smooth {
+        static constexpr bool uses_diffuse = true;
+        static constexpr bool uses_texcoord = false;
 
-    double barycentricA = eval0 / area_full_triangle;
-    double barycentricB = eval1 / area_full_triangle;
-    double barycentricC = 1 - barycentricA - barycentricB;
+        explicit Smooth(GLPbo::Instance const&) {}
+        void begin(Triangle const&) {}
+        GLPbo::Color shade(Triangle const& t, double l0, double l1, double l2, double) const {
+            glm::dvec3 clr = (l0 * t.d[0] + l1 * t.d[1] + l2 * t.d[2]) * CORE10::intensity;
+            return { static_cast<GLubyte>(clr.x * 255), static_cast<GLubyte>(clr.y * 255), static_cast<GLubyte>(clr.z * 255) };
+        }
+    };
 
-    double incXA = e0.a / area_full_triangle;
-    double incXB = e1.a / area_full_triangle;
-    double incXC = e2.a / area_full_triangle;
+    // unlit texture map
+    struct Textured {
+        static constexpr bool uses_diffuse = false;
+        static constexpr bool uses_texcoord = true;
 
-    double incYA = e0.b / area_full_triangle;
-    double incYB = e1.b / area_full_triangle;
-    double incYC = e2.b / area_full_triangle;
+        GLTexture const& texture;
+        TextureLod lod;
 
+        explicit Textured(GLPbo::Instance const& i) : texture{ *i.texture } {}
+        void begin(Triangle const& t) {
+            lod.begin(t, texture);
+        }
+        GLPbo::Color shade(Triangle const& t, double l0, double l1, double l2, double) const {
+            glm::dvec2 uv = texcoord(t, l0, l1, l2);
+            glm::vec3 texClr = sample_texture(texture, uv, lod.at(texture, l0, l1, l2, uv));
+            return { static_cast<GLubyte>(texClr.x), static_cast<GLubyte>(texClr.y), static_cast<GLubyte>(texClr.z) };
+        }
+    };
 
-    double e0a = e0.a, e1a = e1.a, e2a = e2.a;
-    double e0b = e0.b, e1b = e1.b, e2b = e2.b;
-    int intMaxX = static_cast<int>(maxX);
-    int intMaxY = static_cast<int>(maxY);
-    int intMinX = static_cast<int>(minX);
-    int intMinY = static_cast<int>(minY);
+    // texture map modulated by one diffuse term per triangle
+    struct FacetedTextured {
+        static constexpr bool uses_diffuse = false;
+        static constexpr bool uses_texcoord = true;
 
+        GLPbo::Instance const& inst;
+        GLTexture const& texture;
+        glm::dvec3 incomingLight;
+        TextureLod lod;
 
-    for (int y = intMinY; y < intMaxY; ++y) {
-        double HEVal0 = eval0;
-        double HEVal1 = eval1;
-        double HEVal2 = eval2;
+        explicit FacetedTextured(GLPbo::Instance const& i) : inst{ i }, texture{ *i.texture } {}
+        void begin(Triangle const& t) {
+            incomingLight = facet_light(inst, t.id);
+            lod.begin(t, texture);
+        }
+        GLPbo::Color shade(Triangle const& t, double l0, double l1, double l2, double) const {
+            glm::dvec2 uv = texcoord(t, l0, l1, l2);
+            glm::vec3 texClr = sample_texture(texture, uv, lod.at(texture, l0, l1, l2, uv));
+            return { static_cast<GLubyte>(texClr.x * incomingLight.x), static_cast<GLubyte>(texClr.y * incomingLight.y), static_cast<GLubyte>(texClr.z * incomingLight.z) };
+        }
+    };
 
-        double HEa = barycentricA;
-        double HEb = barycentricB;
-        double HEc = barycentricC;
+    // texture map modulated by interpolated per-vertex diffuse terms
+    struct SmoothTextured {
+        static constexpr bool uses_diffuse = true;
+        static constexpr bool uses_texcoord = true;
 
-        for (int x = intMinX; x < intMaxX; ++x)
-        {
-            if ((y < 0 || y >= height) || (x < 0 || x >= width)) { continue; }
-            if (PointInTriangleOptimized(HEVal0, HEVal1, HEVal2, { x + 0.5, y + 0.5 }, e0.topLeft, e1.topLeft, e2.topLeft))
-            {
-                glm::dvec2 texPos = (HEVal0 * tx0 + HEVal1 * tx1 + HEVal2 * tx2) / area_full_triangle;
-                int buffer_idx = y * GLPbo::width + x;  // Adjusted buffer index calculation
-                double z = HEa * p0.z + HEb * p1.z + HEc * p2.z;
-                GLuint texX = static_cast<int>(std::clamp(texPos.x, 0.0, 1.0) * (textureHeight - 1));
-                GLuint texY = static_cast<int>(std::clamp(texPos.y, 0.0, 1.0) * (textureWidth - 1));
-                if (z < depthBuffer[buffer_idx] && texX > 0 && texY > 0 && texX < textureHeight && texY < textureWidth)
-                {
-                    int textureIndex = texY * textureWidth + texX;
-                    glm::vec3 texClr = textureArray[textureIndex];
-                    depthBuffer[buffer_idx] = z;
-                    set_pixel(x, y, { static_cast<GLubyte>(texClr.x),static_cast<GLubyte>(texClr.y),static_cast<GLubyte>(texClr.z) });
-                }
-            }
-            HEVal0 += e0a;
-            HEVal1 += e1a;
-            HEVal2 += e2a;
+        GLTexture const& texture;
+        TextureLod lod;
 
-            HEa += incXA;
-            HEb += incXB;
-            HEc += incXC;
+        explicit SmoothTextured(GLPbo::Instance const& i) : texture{ *i.texture } {}
+        void begin(Triangle const& t) {
+            lod.begin(t, texture);
         }
-        eval0 += e0b;
-        eval1 += e1b;
-        eval2 += e2b;
-
-        barycentricA += incYA;
-        barycentricB += incYB;
-        barycentricC += incYC;
-
-    }
-    return true;
+        GLPbo::Color shade(Triangle const& t, double l0, double l1, double l2, double) const {
+            glm::dvec3 clr = (l0 * t.d[0] + l1 * t.d[1] + l2 * t.d[2]) * CORE10::intensity;
+            glm::dvec2 uv = texcoord(t, l0, l1, l2);
+            glm::vec3 texClr = sample_texture(texture, uv, lod.at(texture, l0, l1, l2, uv));
+            return { static_cast<GLubyte>(clr.x * texClr.x), static_cast<GLubyte>(clr.y * texClr.y), static_cast<GLubyte>(clr.z * texClr.z) };
+        }
+    };
 }
 
 /**
- * @brief Renders a faceted texture map with shading on a triangle using barycentric interpolation.
- *
- * This function renders a faceted texture map on a triangle specified by its three vertices (p0, p1, p2) and
- * their corresponding texture coordinates (tx0, tx1, tx2). The texture map is applied to the triangle using
- * barycentric interpolation to calculate the texture position for each pixel inside the triangle. Additionally,
- * the function performs shading calculations based on the light position, intensity, and the triangle's surface normal
- * to create a faceted shading effect.
- *
- * @param p0 The first vertex of the triangle.
- * @param p1 The second vertex of the triangle.
- * @param p2 The third vertex of the triangle.
- * @param m0 The position of the first vertex in model space.
- * @param m1 The position of the second vertex in model space.
- * @param m2 The position of the third vertex in model space.
- * @param tx0 The texture coordinates at vertex p0.
- * @param tx1 The texture coordinates at vertex p1.
- * @param tx2 The texture coordinates at vertex p2.
- *
- * @return Always returns true, indicating that the rendering of the faceted textured triangle was successful.
- */
-bool GLPbo::render_faceted_texture(glm::dvec3 const& p0, glm::dvec3 const& p1, glm::dvec3 const& p2, 
-    glm::dvec3 const& m0, glm::dvec3 const& m1, glm::dvec3 const& m2, 
-    glm::dvec2 const& tx0, glm::dvec2 const& tx1, glm::dvec2 const& tx2)
+@brief Rasterizes the triangles of one instance in a tile with shading policy Shader.
+This is the single triangle setup and traversal loop shared by all shading
+modes. The vertex attributes requested by the policy are fetched (or
+interpolated for the pieces of clipped triangles), the triangle is set up by
+the fixed-point rasterizer core, and every covered fragment is depth tested
+against the Hi-Z and depth buffers before it is shaded. Depth is the
+interpolated NDC z mapped to [0, 1]; all other attributes are interpolated
+with the perspective-correct barycentric coordinates of the rasterizer. The number of fragments rejected by the
+Hi-Z buffer is added to the frame's counter.
+
+@param tile The tile to rasterize.
+@param inst The instance that owns the triangles.
+@param tris The triangles of inst binned into the tile.
+@param clipped The pieces of clipped triangles of inst binned into the tile.
+*/
+template <typename Shader>
+void GLPbo::draw_tile(Tile const& tile, Instance const& inst,
+    std::span<TriRef const> tris, std::span<GLuint const> clipped)
 {
-    EdgeEqn e0, e1, e2;
-
-    // Edge equation of the 3 lines
-    computeEdgeEqn(p1, p2, e0);
-    computeEdgeEqn(p2, p0, e1);
-    computeEdgeEqn(p0, p1, e2);
-
-    double area_full_triangle = ((p1.x - p0.x) * (p2.y - p0.y) - (p2.x - p0.x) * (p1.y - p0.y));
-
-    // Bounding box of the triangle
-    GLdouble minX = floor(std::min({ p0.x, p1.x, p2.x }));
-    GLdouble maxX = ceil(std::max({ p0.x, p1.x, p2.x }));
-    GLdouble minY = floor(std::min({ p0.y, p1.y, p2.y }));
-    GLdouble maxY = ceil(std::max({ p0.y, p1.y, p2.y }));
+    Shader shader(inst);
+    Model const& model = *inst.model;
+    SHADER::Triangle src, t;
+    std::uint64_t rejected = 0;
 
-    double eVal0 = calculateEdgeEqn_TopLeft(e0, { minX + 0.5f, minY + 0.5f, 0 });
-    double eVal1 = calculateEdgeEqn_TopLeft(e1, { minX + 0.5f, minY + 0.5f, 0 });
-    double eVal2 = calculateEdgeEqn_TopLeft(e2, { minX + 0.5f, minY + 0.5f, 0 });
-
-    double barycentric_a = eVal0 / area_full_triangle;
-    double barycentric_b = eVal1 / area_full_triangle;
-    double barycentric_c = eVal2 / area_full_triangle;
-
-    double incrementX_a = e0.a / area_full_triangle;
-    double incrementX_b = e1.a / area_full_triangle;
-    double incrementX_c = e2.a / area_full_triangle;
-
-    double incrementY_a = e0.b / area_full_triangle;
-    double incrementY_b = e1.b / area_full_triangle;
-    double incrementY_c = e2.b / area_full_triangle;
-
-    double e0a = e0.a, e1a = e1.a, e2a = e2.a;
-    double e0b = e0.b, e1b = e1.b, e2b = e2.b;
-
-    int intMaxX = static_cast<int>(maxX);
-    int intMaxY = static_cast<int>(maxY);
-    int intMinX = static_cast<int>(minX);
-    int intMinY = static_cast<int>(minY);
-
-    glm::mat3 inverse_transform = glm::inverse(current_mdl_iterator->second.ModelTrans);
-
-    double Cx = (m0.x + m1.x + m2.x) * 0.333;
-    double Cy = (m0.y + m1.y + m2.y) * 0.333;
-    double Cz = (m0.z + m1.z + m2.z) * 0.333;
-
-    glm::dvec3 centroid = glm::dvec3(Cx, Cy, Cz);
-
-    glm::dvec3 AB = m1 - m0;
-    glm::dvec3 AC = m2 - m0;
-    glm::dvec3 outwardNormal = glm::normalize(glm::cross(AB, AC));
-
-    glm::dvec3 lightpos = CORE10::light_pos_rotated;
-    lightpos = inverse_transform * lightpos;
-    glm::dvec3 vectorToLight = lightpos - centroid;
-    glm::dvec3 normalisedvectorToLight = glm::normalize(vectorToLight);
-
-    double dotProduct = glm::dot(outwardNormal, normalisedvectorToLight);
-   
-    glm::dvec3 incomingLight = glm::max(0.0, dotProduct) * CORE10::intensity;
-
-    for (int y = intMinY; y < intMaxY; ++y)
+    // fetch the vertex attributes of the triangle at offset i in Model::tri
+    auto fetch = [&model, &inst](GLuint i, SHADER::Triangle& out)
     {
-        double HEVal0 = eVal0;
-        double HEVal1 = eVal1;
-        double HEVal2 = eVal2;
+        out.id = i;
+        for (int v = 0; v < 3; ++v)
+        {
+            GLuint idx = model.tri[i + v];
+            out.p[v] = inst.pd[idx];
+            out.q[v] = inst.pw[idx];
+            if constexpr (Shader::uses_diffuse) { out.d[v] = inst.vd[idx]; }
+            if constexpr (Shader::uses_texcoord) { out.t[v] = model.tex[idx]; }
+        }
+    };
 
-        double HEa = barycentric_a;
-        double HEb = barycentric_b;
-        double HEc = barycentric_c;
+    auto raster = [&shader, &tile, &rejected](SHADER::Triangle const& t)
+    {
+        RASTER::Setup setup;
+        if (!RASTER::setup_triangle(t.p[0], t.p[1], t.p[2], t.q, setup))
+        {
+            return;
+        }
+        shader.begin(t);
 
-        for (int x = intMinX; x < intMaxX; ++x)
+        RASTER::traverse(setup, tile, [&](double l0, double l1, double l2, double z)
         {
-            if ((y < 0 || y >= height) || (x < 0 || x >= width)) { continue; }
-            if (PointInTriangleOptimized(HEVal0, HEVal1, HEVal2, { x + 0.5, y + 0.5 }, e0.topLeft, e1.topLeft, e2.topLeft))
-            {
-                glm::dvec2 texPos = (HEVal0 * tx0 + HEVal1 * tx1 + HEVal2 * tx2) / area_full_triangle;
-                double z = HEa * p0.z + HEb * p1.z + HEc * p2.z;
-                z = (z + 1) / 2;
-                int buffer_idx = y * GLPbo::width + x;
-                int texX = static_cast<int>(std::clamp(texPos.x, 0.0, 1.0) * (textureHeight - 1));
-                int texY = static_cast<int>(std::clamp(texPos.y, 0.0, 1.0) * (textureWidth - 1));
-                if (z < depthBuffer[buffer_idx])
-                {
-                    int textureIndex = texY * textureWidth + texX;
-                    glm::vec3 texClr = textureArray[textureIndex];
-                    depthBuffer[buffer_idx] = z;
-                    set_pixel(x, y, { static_cast<GLubyte>(texClr.x*incomingLight.x),static_cast<GLubyte>(texClr.y* incomingLight.y),static_cast<GLubyte>(texClr.z* incomingLight.z) });
-                }
+            return shader.shade(t, l0, l1, l2, z);
+        }, rejected);
+    };
 
-            }
-            // plus 'a' is increment it horizontally aka increment x-axis
-            HEVal0 += e0a;
-            HEVal1 += e1a;
-            HEVal2 += e2a;
+    for (TriRef const& ref : tris)
+    {
+        fetch(ref.tri, t);
+        raster(t);
+    }
 
-            HEa += incrementX_a;
-            HEb += incrementX_b;
-            HEc += incrementX_c;
+    // pieces of clipped triangles interpolate their attributes from the
+    // source triangle; their positions were computed by clip_triangle()
+    for (GLuint c : clipped)
+    {
+        ClippedTri const& piece = clipped_tris[c];
+        fetch(piece.tri, src);
+        t.id = src.id;
+        for (int v = 0; v < 3; ++v)
+        {
+            glm::dvec3 const& w = piece.w[v];
+            t.p[v] = glm::dvec3(piece.p[v]);
+            t.q[v] = piece.p[v].w;
+            if constexpr (Shader::uses_diffuse) { t.d[v] = SHADER::interpolate(w, src.d); }
+            if constexpr (Shader::uses_texcoord) { t.t[v] = SHADER::interpolate(w, src.t); }
         }
-        // plus 'b' is increment it vertically aka increment y-axis
-        eVal0 += e0b;
-        eVal1 += e1b;
-        eVal2 += e2b;
-
-        barycentric_a += incrementY_a;
-        barycentric_b += incrementY_b;
-        barycentric_c += incrementY_c;
+        raster(t);
     }
-
-    return true;
+    hiZRejected += rejected;
 }
 
 /**
- * @brief Renders a smoothly shaded texture map on a triangle using barycentric interpolation.
- *
- * This function renders a smoothly shaded texture map on a triangle specified by its three vertices (p0, p1, p2) and
- * their corresponding vertex normals (n0, n1, n2), and texture coordinates (tx0, tx1, tx2). The texture map is applied
- * to the triangle using barycentric interpolation to calculate the texture position for each pixel inside the triangle.
- * Additionally, the function performs shading calculations based on the light position, intensity, and the vertex normals
- * to create a smoothly shaded effect on the textured triangle.
- *
- * @param p0 The first vertex of the triangle.
- * @param p1 The second vertex of the triangle.
- * @param p2 The third vertex of the triangle.
- * @param m0 The position of the first vertex in model space.
- * @param m1 The position of the second vertex in model space.
- * @param m2 The position of the third vertex in model space.
- * @param n0 The vertex normal at vertex p0.
- * @param n1 The vertex normal at vertex p1.
- * @param n2 The vertex normal at vertex p2.
- * @param tx0 The texture coordinates at vertex p0.
- * @param tx1 The texture coordinates at vertex p1.
- * @param tx2 The texture coordinates at vertex p2.
- *
- * @return Always returns true, indicating that the rendering of the smoothly shaded textured triangle was successful.
- */
-bool GLPbo::render_smooth_texture(glm::dvec3 const& p0, glm::dvec3 const& p1, glm::dvec3 const& p2, 
-    glm::vec3 const& m0, glm::vec3 const& m1, glm::vec3 const& m2, 
-    glm::dvec3 const& n0, glm::dvec3 const& n1, glm::dvec3 const& n2, 
-    glm::dvec2 const& tx0, glm::dvec2 const& tx1, glm::dvec2 const& tx2)
+@brief Rasterizes every triangle binned into a tile.
+This function is executed by the worker threads of GLThreadPool; it only
+writes to pixels and depth values inside the tile, so tiles can be processed
+concurrently without synchronization. Both lists of the tile are sorted by
+instance, so they are walked together in runs of triangles of the same
+instance; the shading mode is dispatched once per run to the matching
+instantiation of draw_tile(). The deferred color clear of blocks that no
+triangle reached is resolved afterwards. The time spent in every shading
+mode is added to the matching raster stage of GLProfiler.
+
+@param tile The tile to rasterize.
+*/
+void GLPbo::rasterize_tile(Tile const& tile)
 {
-    //pm0 to lightsource pos
-    glm::dvec3 lightsource = CORE10::light_pos_rotated;
-    glm::dvec3 pm0 = glm::inverse(current_mdl_iterator->second.ModelTrans) * lightsource - m0;
-    glm::dvec3 pm1 = glm::inverse(current_mdl_iterator->second.ModelTrans) * lightsource - m1;
-    glm::dvec3 pm2 = glm::inverse(current_mdl_iterator->second.ModelTrans) * lightsource - m2;
-    pm0 = glm::normalize(pm0);
-    pm1 = glm::normalize(pm1);
-    pm2 = glm::normalize(pm2);
-    glm::dvec3 intensity = CORE10::intensity;
-    glm::dvec3 c0 = intensity * glm::max(0.0, glm::dot(n0, pm0));
-    glm::dvec3 c1 = intensity * glm::max(0.0, glm::dot(n1, pm1));
-    glm::dvec3 c2 = intensity * glm::max(0.0, glm::dot(n2, pm2));
-
-    EdgeEqn e0, e1, e2;
-
-    // E1dge equation of the 3 lines0
-    computeEdgeEqn(p1, p2, e0);
-    computeEdgeEqn(p2, p0, e1);
-    computeEdgeEqn(p0, p1, e2);
-
-    double area_full_triangle = ((p1.x - p0.x) * (p2.y - p0.y) - (p2.x - p0.x) * (p1.y - p0.y));
-
-    // Bounding box of the triangle
-    GLdouble minX = floor(std::min({ p0.x, p1.x, p2.x }));
-    GLdouble maxX = ceil(std::max({ p0.x, p1.x, p2.x }));
-    GLdouble minY = floor(std::min({ p0.y, p1.y, p2.y }));
-    GLdouble maxY = ceil(std::max({ p0.y, p1.y, p2.y }));
-
-    double eVal0 = calculateEdgeEqn_TopLeft(e0, { minX + 0.5f, minY + 0.5f, 0 });
-    double eVal1 = calculateEdgeEqn_TopLeft(e1, { minX + 0.5f, minY + 0.5f, 0 });
-    double eVal2 = calculateEdgeEqn_TopLeft(e2, { minX + 0.5f, minY + 0.5f, 0 });
-
-    double barycentric_a = eVal0 / area_full_triangle;
-    double barycentric_b = eVal1 / area_full_triangle;
-    double barycentric_c = eVal2 / area_full_triangle;
-
-    double incrementX_a = e0.a / area_full_triangle;
-    double incrementX_b = e1.a / area_full_triangle;
-    double incrementX_c = e2.a / area_full_triangle;
-
-    double incrementY_a = e0.b / area_full_triangle;
-    double incrementY_b = e1.b / area_full_triangle;
-    double incrementY_c = e2.b / area_full_triangle;
-
-
-    double e0a = e0.a, e1a = e1.a, e2a = e2.a;
-    double e0b = e0.b, e1b = e1.b, e2b = e2.b;
-
-    int intMaxX = static_cast<int>(maxX);
-    int intMaxY = static_cast<int>(maxY);
-    int intMinX = static_cast<int>(minX);
-    int intMinY = static_cast<int>(minY);
-
-
-    for (int y = intMinY; y < intMaxY; ++y) {
-        double HEVal0 = eVal0;
-        double HEVal1 = eVal1;
-        double HEVal2 = eVal2;
-
-        double HEa = barycentric_a;
-        double HEb = barycentric_b;
-        double HEc = barycentric_c;
-
-        for (int x = intMinX; x < intMaxX; ++x)
+    // worker time per shading mode, added to the profiler once per tile
+    constexpr int mode_cnt = GLProfiler::raster_smooth_tex - GLProfiler::raster_wireframe + 1;
+    std::chrono::steady_clock::duration mode_time[mode_cnt]{};
+    size_t t = 0, c = 0;
+    while (t < tile.tris.size() || c < tile.clipped.size())
+    {
+        // the instance of the next run is the lower of the two lists' heads
+        GLuint inst = std::min(
+            t < tile.tris.size() ? tile.tris[t].inst : ~0u,
+            c < tile.clipped.size() ? clipped_tris[tile.clipped[c]].inst : ~0u);
+        size_t t_end = t, c_end = c;
+        while (t_end < tile.tris.size() && tile.tris[t_end].inst == inst)
         {
-            if ((y < 0 || y >= height) || (x < 0 || x >= width)) { continue; }
-            if (PointInTriangleOptimized(HEVal0, HEVal1, HEVal2, { x + 0.5, y + 0.5 }, e0.topLeft, e1.topLeft, e2.topLeft))
-            {
-                glm::dvec2 texPos = (HEVal0 * tx0 + HEVal1 * tx1 + HEVal2 * tx2) / area_full_triangle;
-                int texX = static_cast<int>(std::clamp(texPos.x, 0.0, 1.0) * (textureHeight - 1));
-                int texY = static_cast<int>(std::clamp(texPos.y, 0.0, 1.0) * (textureWidth - 1));
-                double z = HEa * p0.z + HEb * p1.z + HEc * p2.z;
-                z = (z + 1) / 2;
-                int buffer_idx = y * GLPbo::width + x;
-
-                if (z < depthBuffer[buffer_idx])
-                {
-                    glm::dvec3 clr = HEa * c0 + HEb * c1 + HEc * c2;
-                    int textureIndex = texY * textureWidth + texX;
-                    glm::vec3 texClr = textureArray[textureIndex];
-                    depthBuffer[buffer_idx] = z;
-                    set_pixel(x, y, { static_cast<GLubyte>(clr.x * texClr.x),static_cast<GLubyte>(clr.y * texClr.y),static_cast<GLubyte>(clr.z * texClr.z) });
-                }
-
-            }
-            HEVal0 += e0a;
-            HEVal1 += e1a;
-            HEVal2 += e2a;
-
-            HEa += incrementX_a;
-            HEb += incrementX_b;
-            HEc += incrementX_c;
+            ++t_end;
         }
-        eVal0 += e0b;
-        eVal1 += e1b;
-        eVal2 += e2b;
-
-        barycentric_a += incrementY_a;
-        barycentric_b += incrementY_b;
-        barycentric_c += incrementY_c;
+        while (c_end < tile.clipped.size() && clipped_tris[tile.clipped[c_end]].inst == inst)
+        {
+            ++c_end;
+        }
+        std::span<TriRef const> tris(tile.tris.data() + t, t_end - t);
+        std::span<GLuint const> clipped(tile.clipped.data() + c, c_end - c);
+        Instance const& instance = instances[inst];
 
+        auto start = std::chrono::steady_clock::now();
+        switch (instance.Tasking)
+        {
+        case GLPbo::Model::task::depth:       draw_tile<SHADER::DepthBuffer>(tile, instance, tris, clipped); break;
+        case GLPbo::Model::task::faceted:     draw_tile<SHADER::Faceted>(tile, instance, tris, clipped); break;
+        case GLPbo::Model::task::shaded:      draw_tile<SHADER::Smooth>(tile, instance, tris, clipped); break;
+        case GLPbo::Model::task::textured:    draw_tile<SHADER::Textured>(tile, instance, tris, clipped); break;
+        case GLPbo::Model::task::faceted_tex: draw_tile<SHADER::FacetedTextured>(tile, instance, tris, clipped); break;
+        case GLPbo::Model::task::smooth_tex:  draw_tile<SHADER::SmoothTextured>(tile, instance, tris, clipped); break;
+        default: break;
+        }
+        int mode = static_cast<int>(instance.Tasking);
+        if (mode >= 0 && mode < mode_cnt)
+        {
+            mode_time[mode] += std::chrono::steady_clock::now() - start;
+        }
+        t = t_end;
+        c = c_end;
     }
-    return true;
+    for (int m = 0; m < mode_cnt; ++m)
+    {
+        if (mode_time[m].count() != 0)
+        {
+            GLProfiler::add(static_cast<GLProfiler::Stage>(GLProfiler::raster_wireframe + m), mode_time[m]);
+        }
+    }
+    resolve_tile(tile);
 }
 
+/**
+ * @brief Sets up a texture object using data from a binary file.
+ *
+ * This function reads texture data from a binary file specified by the given `pathname`
+ * and sets up a texture object (texobj) with the loaded data. The file starts with the
+ * width, height and bytes per texel of the texture, which may be of any size.
+ * Every texture is loaded once and then shared by all instances that name it.
+ *
+ * @param pathname The path to the binary file containing texture data.
+ * @return The texture object, or nullptr if the file could not be read.
+ */
+GLTexture const* GLPbo::setup_texobj(std::string pathname) {
 
+    auto it = textureMap.find(pathname);
+    if (it != textureMap.end()) {
+        return &it->second;
+    }
+    std::string file = "../images/" + pathname + ".tex";
+    GLTexture texture;
+    if (!texture.load(file)) {
+        return nullptr;
+    }
+    return &textureMap.emplace(pathname, std::move(texture)).first->second;
+}
@@ -0,0 +1,343 @@
+/*!
+@file		glprofiler.cpp
+@author		benjaminzhiyuan.lee@digipen.edu
+@date		17/10/2026
+
+This file implements structure GLProfiler. Stage times of the open frame are
+accumulated in atomic nanosecond counters so that worker threads can add to
+them without locks; closing a frame converts the counters to milliseconds
+and stores them in the ring. Timer queries of every GPU stage form a small
+ring of their own so that results are only read once they are available.
+
+*//*__________________________________________________________________________*/
+
+/*                                                                   includes
+----------------------------------------------------------------------------- */
+#include <glprofiler.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <vector>
+
+/*                                                   objects with file scope
+----------------------------------------------------------------------------- */
+namespace
+{
+    using Record = std::array<double, GLProfiler::stage_count>;
+
+    std::array<Record, GLProfiler::history> ring{};
+    GLuint ring_head{};  // slot of the next frame to be stored
+    GLuint ring_count{};
+
+    std::atomic<std::int64_t> open_ns[GLProfiler::stage_count]{};
+    bool frame_open{ false };
+    std::chrono::steady_clock::time_point frame_start;
+
+    // timer queries of a GPU stage - queries are issued in ring order and
+    // the oldest pending ones are read back first
+    constexpr GLuint gpu_latency = 4;
+    struct GpuTimer {
+        GLuint ids[gpu_latency]{};
+        bool pending[gpu_latency]{};
+        GLuint next{};       // slot of the next query to issue
+        bool active{ false }; // a query of this stage has begun
+    };
+    GpuTimer gpu_timers[GLProfiler::stage_count];
+    constexpr GLProfiler::Stage gpu_stages[] = { GLProfiler::gpu_upload, GLProfiler::gpu_quad };
+    bool gpu_ready{ false };
+
+    char const* const stage_names[GLProfiler::stage_count] = {
+        "frame", "emulate", "pbo_wait", "clear", "vertex", "cull", "lighting", "bin", "raster",
+        "raster_wireframe", "raster_depth", "raster_faceted", "raster_shaded", "raster_textured",
+        "raster_faceted_tex", "raster_smooth_tex", "upload", "present", "gpu_upload", "gpu_quad",
+    };
+
+    // i-th oldest frame in the ring
+    Record const& frame_record(GLuint i)
+    {
+        return ring[(ring_head + GLProfiler::history - ring_count + i) % GLProfiler::history];
+    }
+
+    /**
+    @brief Reads the results of the pending queries of a GPU stage.
+    Queries complete in the order they were issued, so reading stops at the
+    first one whose result is not available yet.
+    */
+    void collect(GLProfiler::Stage stage)
+    {
+        GpuTimer& timer = gpu_timers[stage];
+        for (GLuint n = 0; n < gpu_latency; ++n)
+        {
+            GLuint slot = (timer.next + n) % gpu_latency;
+            if (!timer.pending[slot])
+            {
+                continue;
+            }
+            GLint available = GL_FALSE;
+            glGetQueryObjectiv(timer.ids[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+            {
+                return;
+            }
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(timer.ids[slot], GL_QUERY_RESULT, &ns);
+            timer.pending[slot] = false;
+            GLProfiler::add(stage, std::chrono::nanoseconds(ns));
+        }
+    }
+}
+
+/**
+@brief Closes the open frame, if any, and opens a new one.
+*/
+void GLProfiler::begin_frame()
+{
+    end_frame();
+    frame_open = true;
+    frame_start = std::chrono::steady_clock::now();
+}
+
+/**
+@brief Stores the open frame in the ring.
+The frame stage is the time since begin_frame(); all other stages are the
+times added to the frame.
+*/
+void GLProfiler::end_frame()
+{
+    if (!frame_open)
+    {
+        return;
+    }
+    frame_open = false;
+    add(frame, std::chrono::steady_clock::now() - frame_start);
+
+    Record& record = ring[ring_head];
+    for (GLuint s = 0; s < stage_count; ++s)
+    {
+        record[s] = static_cast<double>(open_ns[s].exchange(0, std::memory_order_relaxed)) * 1e-6;
+    }
+    ring_head = (ring_head + 1) % history;
+    ring_count = std::min(ring_count + 1, history);
+}
+
+/**
+@brief Adds a time to a stage of the open frame.
+
+@param stage The stage.
+@param t The time to add.
+*/
+void GLProfiler::add(Stage stage, std::chrono::steady_clock::duration t)
+{
+    open_ns[stage].fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(t).count(),
+        std::memory_order_relaxed);
+}
+
+/**
+@brief Creates the timer queries of the GPU stages.
+Stages other than gpu_upload and gpu_quad are never timed by the GPU.
+*/
+void GLProfiler::init_gpu()
+{
+    for (Stage stage : gpu_stages)
+    {
+        gpu_timers[stage] = GpuTimer{};
+        glGenQueries(gpu_latency, gpu_timers[stage].ids);
+    }
+    gpu_ready = true;
+}
+
+/**
+@brief Deletes the timer queries of the GPU stages.
+*/
+void GLProfiler::cleanup_gpu()
+{
+    if (!gpu_ready)
+    {
+        return;
+    }
+    for (Stage stage : gpu_stages)
+    {
+        glDeleteQueries(gpu_latency, gpu_timers[stage].ids);
+        gpu_timers[stage] = GpuTimer{};
+    }
+    gpu_ready = false;
+}
+
+/**
+@brief Begins the timer query of a GPU stage.
+The results of earlier queries of the stage that are available are added to
+the open frame first. If every query of the stage is still pending, the
+stage is not timed this frame rather than stalling until a query completes.
+
+@param stage The stage.
+*/
+void GLProfiler::gpu_begin(Stage stage)
+{
+    if (!gpu_ready)
+    {
+        return;
+    }
+    collect(stage);
+    GpuTimer& timer = gpu_timers[stage];
+    timer.active = !timer.pending[timer.next];
+    if (timer.active)
+    {
+        glBeginQuery(GL_TIME_ELAPSED, timer.ids[timer.next]);
+    }
+}
+
+/**
+@brief Ends the timer query of a GPU stage begun by gpu_begin().
+
+@param stage The stage.
+*/
+void GLProfiler::gpu_end(Stage stage)
+{
+    GpuTimer& timer = gpu_timers[stage];
+    if (!timer.active)
+    {
+        return;
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+    timer.active = false;
+    timer.pending[timer.next] = true;
+    timer.next = (timer.next + 1) % gpu_latency;
+}
+
+/**
+@brief Returns the number of frames in the ring.
+*/
+GLuint GLProfiler::frames()
+{
+    return ring_count;
+}
+
+/**
+@brief Computes the statistics of a stage over the frames in the ring.
+The 99th percentile is the smallest time that is not exceeded by 99% of the
+frames.
+
+@param stage The stage.
+@return The minimum, average and 99th percentile in milliseconds, or zeros
+if the ring is empty.
+*/
+GLProfiler::Stats GLProfiler::stats(Stage stage)
+{
+    if (ring_count == 0)
+    {
+        return { 0.0, 0.0, 0.0 };
+    }
+    std::vector<double> times(ring_count);
+    double sum = 0.0;
+    for (GLuint i = 0; i < ring_count; ++i)
+    {
+        times[i] = frame_record(i)[stage];
+        sum += times[i];
+    }
+    size_t rank = (times.size() * 99 + 99) / 100 - 1;
+    std::nth_element(times.begin(), times.begin() + rank, times.end());
+    double p99 = times[rank];
+    return { *std::min_element(times.begin(), times.end()), sum / ring_count, p99 };
+}
+
+/**
+@brief Returns the time of a stage in the most recent frame in the ring.
+*/
+double GLProfiler::last(Stage stage)
+{
+    return ring_count > 0 ? frame_record(ring_count - 1)[stage] : 0.0;
+}
+
+/**
+@brief Returns the name of a stage as used by the exported files.
+*/
+char const* GLProfiler::name(Stage stage)
+{
+    return stage < stage_count ? stage_names[stage] : "";
+}
+
+/**
+@brief Writes the frames in the ring as comma-separated values.
+
+@param pathname The file to write.
+@return True if the file was written.
+*/
+bool GLProfiler::write_csv(std::string const& pathname)
+{
+    std::ofstream ofs{ pathname };
+    if (!ofs)
+    {
+        return false;
+    }
+    ofs << "frame_index";
+    for (GLuint s = 0; s < stage_count; ++s)
+    {
+        ofs << "," << stage_names[s];
+    }
+    ofs << "\n" << std::fixed << std::setprecision(4);
+    for (GLuint i = 0; i < ring_count; ++i)
+    {
+        ofs << i;
+        for (double t : frame_record(i))
+        {
+            ofs << "," << t;
+        }
+        ofs << "\n";
+    }
+    return static_cast<bool>(ofs);
+}
+
+/**
+@brief Writes the statistics and frame times of every stage as JSON.
+
+@param pathname The file to write.
+@return True if the file was written.
+*/
+bool GLProfiler::write_json(std::string const& pathname)
+{
+    std::ofstream ofs{ pathname };
+    if (!ofs)
+    {
+        return false;
+    }
+    ofs << std::fixed << std::setprecision(4);
+    ofs << "{\n  \"unit\": \"ms\",\n  \"frames\": " << ring_count << ",\n  \"stages\": {";
+    for (GLuint s = 0; s < stage_count; ++s)
+    {
+        Stats st = stats(static_cast<Stage>(s));
+        ofs << (s ? "," : "") << "\n    \"" << stage_names[s] << "\": { \"min\": " << st.min
+            << ", \"avg\": " << st.avg << ", \"p99\": " << st.p99 << ", \"times\": [";
+        for (GLuint i = 0; i < ring_count; ++i)
+        {
+            ofs << (i ? ", " : "") << frame_record(i)[s];
+        }
+        ofs << "] }";
+    }
+    ofs << "\n  }\n}\n";
+    return static_cast<bool>(ofs);
+}
+
+/**
+@brief Prints a table of the statistics of every stage.
+
+@param os The stream to print to.
+*/
+void GLProfiler::print(std::ostream& os)
+{
+    std::ios::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << "stage (ms, " << ring_count << " frames)        min       avg       p99\n"
+        << std::fixed << std::setprecision(3);
+    for (GLuint s = 0; s < stage_count; ++s)
+    {
+        Stats st = stats(static_cast<Stage>(s));
+        os << std::left << std::setw(28) << stage_names[s] << std::right
+            << std::setw(10) << st.min << std::setw(10) << st.avg << std::setw(10) << st.p99 << "\n";
+    }
+    os.flags(flags);
+    os.precision(precision);
+}
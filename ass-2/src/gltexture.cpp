@@ -0,0 +1,268 @@
+/*!
+@file		gltexture.cpp
+@author		benjaminzhiyuan.lee@digipen.edu
+@date		17/10/2026
+
+This file implements structure GLTexture. Texels are stored as RGBA8 and
+expanded to single precision when they are fetched; the level of detail
+follows the OpenGL specification, i.e. the log2 of the larger of the two
+screen-space texel footprints.
+
+*//*__________________________________________________________________________*/
+
+/*                                                                   includes
+----------------------------------------------------------------------------- */
+#include <gltexture.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+namespace {
+    // spreads the 3 low bits of v so that they occupy bits 0, 2 and 4
+    constexpr GLuint spread3(GLuint v)
+    {
+        return (v & 1u) | ((v & 2u) << 1) | ((v & 4u) << 2);
+    }
+
+    // one level with its tile storage allocated for width x height texels
+    GLTexture::Level make_level(GLint width, GLint height)
+    {
+        GLint ts = GLTexture::tile_size;
+        GLTexture::Level level{ width, height, (width + ts - 1) / ts, {} };
+        GLint tiles_y = (height + ts - 1) / ts;
+        level.texels.resize(static_cast<size_t>(level.tiles_x) * tiles_y * ts * ts);
+        return level;
+    }
+
+    // average of four RGBA8 texels, rounded per channel
+    GLuint average(GLuint a, GLuint b, GLuint c, GLuint d)
+    {
+        GLuint out = 0;
+        for (GLuint shift = 0; shift < 32; shift += 8)
+        {
+            GLuint sum = ((a >> shift) & 0xFFu) + ((b >> shift) & 0xFFu)
+                + ((c >> shift) & 0xFFu) + ((d >> shift) & 0xFFu);
+            out |= ((sum + 2) >> 2) << shift;
+        }
+        return out;
+    }
+}
+
+/**
+@brief Returns the offset of texel (x, y) in the tiled storage of a level.
+The tile holding the texel is found first; the low 3 bits of x and y are
+then interleaved into the texel's Morton index inside the tile.
+*/
+size_t GLTexture::offset(Level const& level, GLint x, GLint y)
+{
+    static_assert(tile_size == 8, "the Morton index is built from 3 bits of x and y");
+    size_t tile = static_cast<size_t>(y >> 3) * level.tiles_x + static_cast<size_t>(x >> 3);
+    GLuint morton = spread3(static_cast<GLuint>(x) & 7u) | (spread3(static_cast<GLuint>(y) & 7u) << 1);
+    return tile * (tile_size * tile_size) + morton;
+}
+
+/**
+@brief Loads a .tex file.
+The whole file is read into memory at once and the texels are converted to
+RGBA8; channels missing from the file are 0 except alpha, which is opaque.
+The images of the tutorials have no header: a file without a valid header
+that holds exactly raw_size x raw_size RGBA texels is read as such an image.
+
+@param pathname The path of the .tex file.
+@return true if the texture was loaded.
+*/
+bool GLTexture::load(std::string const& pathname)
+{
+    std::ifstream ifs{ pathname, std::ios::binary | std::ios::ate };
+    if (!ifs)
+    {
+        return false;
+    }
+    std::streamsize size = ifs.tellg();
+    std::vector<unsigned char> bytes(static_cast<size_t>(std::max<std::streamsize>(size, 0)));
+    ifs.seekg(0, std::ios::beg);
+    if (!ifs.read(reinterpret_cast<char*>(bytes.data()), size))
+    {
+        return false;
+    }
+
+    // header: width and height in texels, bytes per texel
+    GLint header[3]{};
+    if (bytes.size() < sizeof(header))
+    {
+        return false;
+    }
+    std::memcpy(header, bytes.data(), sizeof(header));
+    GLint width = header[0], height = header[1], bpt = header[2];
+    size_t header_size = sizeof(header);
+    if (width <= 0 || height <= 0 || bpt <= 0
+        || (bytes.size() - sizeof(header)) / bpt / width < static_cast<size_t>(height))
+    {
+        constexpr GLint raw_size = 256;
+        if (bytes.size() != static_cast<size_t>(raw_size) * raw_size * 4)
+        {
+            return false;
+        }
+        width = height = raw_size;
+        bpt = 4;
+        header_size = 0;
+    }
+
+    size_t count = static_cast<size_t>(width) * height;
+    size_t channels = static_cast<size_t>(std::min(bpt, 4));
+    std::vector<GLuint> texels(count);
+    unsigned char const* src = bytes.data() + header_size;
+    for (size_t i = 0; i < count; ++i, src += bpt)
+    {
+        GLuint rgba = channels < 4 ? 0xFF000000u : 0u;
+        for (size_t c = 0; c < channels; ++c)
+        {
+            rgba |= static_cast<GLuint>(src[c]) << (8 * c);
+        }
+        texels[i] = rgba;
+    }
+    build(width, height, texels);
+    return true;
+}
+
+/**
+@brief Builds the mip chain of a texture.
+Every level halves the dimensions of the previous one (rounding down, but
+never below 1) and averages the texels of the previous level that it covers;
+texels past the last row or column of an odd-sized level are clamped.
+
+@param width The width of texels.
+@param height The height of texels.
+@param texels The full-resolution image in row-major order.
+*/
+void GLTexture::build(GLint width, GLint height, std::vector<GLuint> const& texels)
+{
+    levels.clear();
+    Level base = make_level(width, height);
+    for (GLint y = 0; y < height; ++y)
+    {
+        for (GLint x = 0; x < width; ++x)
+        {
+            base.texels[offset(base, x, y)] = texels[static_cast<size_t>(y) * width + x];
+        }
+    }
+    levels.push_back(std::move(base));
+
+    while (levels.back().width > 1 || levels.back().height > 1)
+    {
+        Level const& src = levels.back();
+        Level dst = make_level(std::max(src.width / 2, 1), std::max(src.height / 2, 1));
+        for (GLint y = 0; y < dst.height; ++y)
+        {
+            GLint y0 = std::min(2 * y, src.height - 1), y1 = std::min(2 * y + 1, src.height - 1);
+            for (GLint x = 0; x < dst.width; ++x)
+            {
+                GLint x0 = std::min(2 * x, src.width - 1), x1 = std::min(2 * x + 1, src.width - 1);
+                dst.texels[offset(dst, x, y)] = average(
+                    src.texels[offset(src, x0, y0)], src.texels[offset(src, x1, y0)],
+                    src.texels[offset(src, x0, y1)], src.texels[offset(src, x1, y1)]);
+            }
+        }
+        levels.push_back(std::move(dst));
+    }
+}
+
+/**
+@brief Computes the level of detail for the texture coordinate derivatives of a
+fragment.
+
+@param dx The derivative of the texture coordinates along window x.
+@param dy The derivative of the texture coordinates along window y.
+@return log2 of the larger footprint in level 0 texels, clamped to the
+levels of the mip chain.
+*/
+float GLTexture::lod(glm::vec2 const& dx, glm::vec2 const& dy) const
+{
+    if (levels.empty())
+    {
+        return 0.0f;
+    }
+    glm::vec2 size(static_cast<float>(levels[0].width), static_cast<float>(levels[0].height));
+    float rho2 = std::max(glm::dot(dx * size, dx * size), glm::dot(dy * size, dy * size));
+    // log2(sqrt(rho2)) without the square root
+    float l = 0.5f * std::log2(std::max(rho2, 1e-12f));
+    return std::clamp(l, 0.0f, static_cast<float>(levels.size() - 1));
+}
+
+/**
+@brief Returns a texel of a level after applying the wrap mode.
+*/
+glm::vec3 GLTexture::texel(Level const& level, GLint x, GLint y) const
+{
+    if (wrap == Wrap::repeat)
+    {
+        x %= level.width;
+        y %= level.height;
+        x += x < 0 ? level.width : 0;
+        y += y < 0 ? level.height : 0;
+    }
+    else
+    {
+        x = std::clamp(x, 0, level.width - 1);
+        y = std::clamp(y, 0, level.height - 1);
+    }
+    GLuint t = level.texels[offset(level, x, y)];
+    return glm::vec3(static_cast<float>(t & 0xFFu), static_cast<float>((t >> 8) & 0xFFu),
+        static_cast<float>((t >> 16) & 0xFFu));
+}
+
+/**
+@brief Bilinearly filters the four texels of a level around uv.
+*/
+glm::vec3 GLTexture::bilinear(Level const& level, glm::vec2 const& uv) const
+{
+    float fx = uv.x * level.width - 0.5f;
+    float fy = uv.y * level.height - 0.5f;
+    float x0 = std::floor(fx), y0 = std::floor(fy);
+    float ax = fx - x0, ay = fy - y0;
+    GLint ix = static_cast<GLint>(x0), iy = static_cast<GLint>(y0);
+
+    glm::vec3 top = glm::mix(texel(level, ix, iy), texel(level, ix + 1, iy), ax);
+    glm::vec3 bottom = glm::mix(texel(level, ix, iy + 1), texel(level, ix + 1, iy + 1), ax);
+    return glm::mix(top, bottom, ay);
+}
+
+/**
+@brief Samples the texture with its filter mode.
+
+@param uv The texture coordinates.
+@param lod The level of detail returned by lod().
+@return The filtered color with channels in [0, 255].
+*/
+glm::vec3 GLTexture::sample(glm::vec2 const& uv, float lod) const
+{
+    if (levels.empty())
+    {
+        return glm::vec3(255.0f);
+    }
+    // bring the coordinates into [0, 1] first so that texel indices stay
+    // small; texel() still wraps or clamps the neighbors of edge texels
+    glm::vec2 st = wrap == Wrap::repeat ? uv - glm::floor(uv) : glm::clamp(uv, 0.0f, 1.0f);
+    switch (filter)
+    {
+    case Filter::nearest:
+    {
+        Level const& level = levels[0];
+        GLint x = static_cast<GLint>(st.x * level.width);
+        GLint y = static_cast<GLint>(st.y * level.height);
+        return texel(level, x, y);
+    }
+    case Filter::bilinear:
+        return bilinear(levels[static_cast<size_t>(lod + 0.5f)], st);
+    case Filter::trilinear:
+    default:
+    {
+        size_t l0 = static_cast<size_t>(lod);
+        size_t l1 = std::min(l0 + 1, levels.size() - 1);
+        glm::vec3 c0 = bilinear(levels[l0], st);
+        float t = lod - static_cast<float>(l0);
+        return t > 0.0f ? glm::mix(c0, bilinear(levels[l1], st), t) : c0;
+    }
+    }
+}
@@ -16,6 +16,8 @@ initialize an OpenGL context and implement a game loop.
 #include <sstream>
 #include <iomanip>
 #include <cmath>
+#include <string>
+#include <charconv>
 // Don't include glapp.h - we've nothing more to do with that file anymore!!!
 
 /*                                                         type declarations
@@ -27,13 +29,19 @@ static void draw();
 static void update();
 static void init();
 static void cleanup();
+static int run_headless(int frames, std::string const& output, int mode, bool perspective,
+                        std::string const& scene, std::string const& profile);
+static bool parse_int(char const* str, int& value);
 
 /*                                                      function definitions
 ----------------------------------------------------------------------------- */
 /*  _________________________________________________________________________ */
 /*! main
 
-@param none
+@param argc, argv
+Run as "<program> --headless [frames] [output] [mode] [perspective] [scene] [profile]" to
+render without a window; see run_headless(). A frame count or mode that is not
+an integer in range prints the usage and fails.
 
 @return int
 
@@ -41,7 +49,24 @@ Indicates how the program existed. Normal exit is signaled by a return value of
 0. Abnormal termination is signaled by a non-zero return value.
 Note that the C++ compiler will insert a return 0 statement if one is missing.
 */
-int main() {
+int main(int argc, char* argv[]) {
+  if (argc > 1 && std::string(argv[1]) == "--headless") {
+    int frames = 1, mode = -1;
+    if ((argc > 2 && (!parse_int(argv[2], frames) || frames < 0)) ||
+        (argc > 4 && (!parse_int(argv[4], mode) || mode < -1 ||
+                      mode > static_cast<int>(GLPbo::Model::task::smooth_tex)))) {
+      std::cerr << "Usage: " << argv[0] << " --headless [frames >= 0] [output] [mode -1.."
+                << static_cast<int>(GLPbo::Model::task::smooth_tex)
+                << "] [perspective] [scene] [profile]" << std::endl;
+      return EXIT_FAILURE;
+    }
+    std::string output = argc > 3 ? argv[3] : "frame.png";
+    bool perspective = argc > 5 && std::string(argv[5]) == "perspective";
+    std::string scene = argc > 6 ? argv[6] : "";
+    std::string profile = argc > 7 ? argv[7] : "";
+    return run_headless(frames, output, mode, perspective, scene, profile);
+  }
+
   // Part 1
   init();
 
@@ -127,3 +152,76 @@ void cleanup() {
   // Part 2
   GLHelper::cleanup();
 }
+
+/*  _________________________________________________________________________ */
+/*! run_headless
+@param frames
+Number of frames to emulate.
+@param output
+Image file that the last frame is written to (.png or .ppm).
+@param mode
+Shading mode of every instance - see GLPbo::Model::task; a negative mode
+keeps the modes given by the scene file.
+@param perspective
+Whether the camera uses the perspective projection instead of the
+orthographic one.
+@param scene
+Name of the scene file in ../scenes to render instead of the default scene,
+or an empty string.
+@param profile
+Base name of the files that the stage timings of the frames are written to
+(<profile>.csv and <profile>.json), or an empty string. The statistics are
+also printed.
+@return int
+EXIT_SUCCESS if the image was written; EXIT_FAILURE otherwise.
+
+Runs the emulator without a window or OpenGL context and saves the last
+frame, so that images can be rendered on machines without a GPU.
+*/
+static int run_headless(int frames, std::string const& output, int mode, bool perspective,
+                        std::string const& scene, std::string const& profile) {
+  GLPbo::init(2400, 1350, 1, true);
+  if (!scene.empty() && !GLPbo::load_scene(scene)) {
+    GLPbo::cleanup();
+    return EXIT_FAILURE;
+  }
+  if (mode >= 0) {
+    GLPbo::set_render_mode(static_cast<GLPbo::Model::task>(mode));
+  }
+  if (perspective) {
+    GLPbo::Camera cam = GLPbo::camera;
+    cam.projection = GLPbo::Camera::Projection::perspective;
+    GLPbo::set_camera(cam);
+  }
+  for (int i = 0; i < frames; ++i) {
+    GLPbo::emulate();
+  }
+  GLProfiler::end_frame();
+  bool saved = GLPbo::save_frame(output);
+  if (!profile.empty()) {
+    GLProfiler::print(std::cout);
+    saved = GLProfiler::write_csv(profile + ".csv") && GLProfiler::write_json(profile + ".json") && saved;
+  }
+  GLPbo::cleanup();
+  return saved ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*  _________________________________________________________________________ */
+/*! parse_int
+@param str
+Command-line argument to parse.
+@param value
+Set to the parsed integer if the whole argument is one.
+@return bool
+True if str is an integer in the range of int; value is unchanged otherwise.
+*/
+static bool parse_int(char const* str, int& value) {
+  char const* end = str + std::char_traits<char>::length(str);
+  int parsed = 0;
+  auto [ptr, ec] = std::from_chars(str, end, parsed);
+  if (ec != std::errc() || ptr != end) {
+    return false;
+  }
+  value = parsed;
+  return true;
+}
@@ -6,16 +6,18 @@
  * 
  * This shader takes the vertex position and color as input attributes
  * and passes the color to the fragment shader as a varying variable.
+ * The model-to-NDC transform and a tint color are per-instance attributes,
+ * so that every object of a model is drawn by a single instanced draw call.
  */
 #version 450 core
 layout (location=0) in vec2 aVertexPosition;
 layout (location=1) in vec3 aVertexColor;
+layout (location=2) in mat3 aModel_to_NDC; // per instance - locations 2 to 4
+layout (location=5) in vec3 aInstanceColor; // per instance
 layout (location=0) out vec3 vColor;
 
-uniform mat3 uModel_to_NDC;
-
 void main() {
-gl_Position = vec4(vec2(uModel_to_NDC * vec3(aVertexPosition, 1.f)),
+gl_Position = vec4(vec2(aModel_to_NDC * vec3(aVertexPosition, 1.f)),
 0.0, 1.0);
-vColor = aVertexColor;
+vColor = aVertexColor * aInstanceColor;
 }
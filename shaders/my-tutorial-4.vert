@@ -11,9 +11,14 @@
 layout (location = 0) in vec2 aVertexPosition;
 //layout (location = 1) in vec3 aVertexColor;
 //layout (location = 0) out vec3 vColor;
-uniform mat3 uModel_to_NDC;
+// world-to-NDC transform of the camera, shared by every object and
+// every shader program through one std140 uniform buffer
+layout (std140) uniform Camera {
+mat3 uWorld_to_NDC;
+};
+uniform mat3 uModel_to_World;
 void main() {
-gl_Position = vec4(vec2(uModel_to_NDC * vec3(aVertexPosition, 1.f)),
+gl_Position = vec4(vec2(uWorld_to_NDC * uModel_to_World * vec3(aVertexPosition, 1.f)),
 0.0, 1.0);
 //vColor = aVertexColor;
 }
@@ -19,7 +19,6 @@ and transformations (in later labs).
 *//*__________________________________________________________________________*/
 
 #include <glslshader.h>
-#include <list>
 
 /*                                                                      guard
 ----------------------------------------------------------------------------- */
@@ -55,20 +54,74 @@ struct GLApp {
   static GLApp::GLModel mystery_model();
   static void init_models_cont(); // initialize singleton
 
-  // encapsulates rendered object
-  struct GLObject {
-	  glm::vec2 scaling; // scaling
-	  GLfloat angle_speed, angle_disp; // orientation
-	  glm::vec2 position; // translation
+  // per-instance vertex attributes of an object - read by the vertex shader
+  // from vertex buffer binding instance_binding at attribute locations 2 to 4
+  // (the columns of the transform) and 5 (the color)
+  struct GLInstance {
 	  glm::mat3 mdl_to_ndc_xform;
-	  GLuint mdl_ref, shd_ref;
-	  // set up initial state
-	  void init();
-	  void draw() const;
-	  void update(GLdouble delta_time);
+	  glm::vec3 color;
+  };
+  static GLuint const instance_binding = 2;
+
+  // encapsulates rendered objects as a structure of arrays: element i of
+  // every array belongs to the object at dense index i, so that update()
+  // and draw() stream through contiguous memory. Objects are added at the
+  // back and removed from the front, so they stay in the order they were
+  // spawned.
+  struct GLObjects {
+	  std::vector<glm::vec2> scaling; // scaling
+	  std::vector<GLfloat> angle_speed, angle_disp; // orientation
+	  std::vector<glm::vec2> position; // translation
+	  std::vector<glm::vec3> color; // tints the vertex colors of the model
+	  std::vector<GLuint> mdl_ref, shd_ref;
+	  // first instance of each group of objects sharing model m and shader
+	  // program p (group m * shdrpgms.size() + p) - the last element is the
+	  // object count. Set by update().
+	  std::vector<GLuint> group_first;
+
+	  size_t size() const;
+	  // add count objects with random initial state - returns the dense
+	  // index of the first
+	  size_t spawn(size_t count);
+	  // remove the count oldest objects
+	  void kill_front(size_t count);
+	  // set up initial state of object i
+	  void init(size_t i);
+	  // update orientations of all objects and write their instance
+	  // attributes to dst, grouped as described by group_first
+	  void update(GLdouble delta_time, GLInstance* dst);
+
+	  // apply f to every array
+	  template <typename F> void for_each_array(F f) {
+		  f(scaling); f(angle_speed); f(angle_disp); f(position);
+		  f(color); f(mdl_ref); f(shd_ref);
+	  }
   };
   // container for objects ...
-  static std::list<GLApp::GLObject> objects; // singleton
+  static GLObjects objects; // singleton
+
+  // persistently mapped buffer of GLInstance values. The buffer is split into
+  // region_cnt regions of capacity instances each: the CPU fills one region
+  // per frame while the GPU may still read the previous ones, and a fence
+  // keeps a region from being overwritten before the GPU is done with it.
+  struct GLInstanceBuffer {
+	  static GLuint const region_cnt = 3;
+	  GLuint bufid;
+	  GLuint capacity;              // instances per region
+	  GLInstance* mapped;           // mapping of all regions
+	  GLsync fences[region_cnt];
+	  GLuint region;                // region filled this frame
+	  // grow regions to hold at least count instances - contents are lost
+	  void reserve(GLuint count);
+	  // wait until the GPU has released the next region and return it
+	  GLInstance* begin_frame();
+	  // byte offset of instance i of the current region
+	  GLintptr offset(GLuint i) const;
+	  // fence the current region once the draw calls reading it are issued
+	  void end_frame();
+	  void destroy();
+  };
+  static GLInstanceBuffer instances; // singleton
 };
 
 #endif /* GLAPP_H */
@@ -13,7 +13,10 @@ functionality required to load shader source; compile shader source; link
 shader objects into a program object, validate program object; log msesages
 from compiling linking, and validation steps; install program object in
 appropriate shaders; and pass uniform variables from the client to the 
-program object.
+program object. Active uniforms and uniform blocks are reflected once when
+the program is linked, so that uniforms can be set through handles without
+any string lookups. Linked programs are cached on
+disk as program binaries so that later runs skip compilation and linking.
 
 *//*__________________________________________________________________________*/
 
@@ -30,10 +33,12 @@ program object.
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <cstdint>
 #include <cstdlib>
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
 
 /*  _________________________________________________________________________ */
 class GLSLShader
@@ -57,7 +62,16 @@ public:
   // CompileShaderFromFile(). After the shader objects are created, a call to
   // Link() will create a shader executable program. This is followed by a call
   // to Validate() ensuring the program can execute in the current OpenGL state.
+  // The program binary cache is consulted first: if a binary linked from the
+  // same sources by the same driver is on disk, it is loaded instead and no
+  // shader is compiled. Otherwise the binary of the newly linked program is
+  // written to the cache for the next run.
   GLboolean CompileLinkValidate(std::vector<std::pair<GLenum, std::string>>);
+
+  // Directory in which CompileLinkValidate() keeps program binaries - the
+  // working directory by default. An empty string disables the cache.
+  // The directory must exist; it is not created.
+  static void SetBinaryCacheDirectory(std::string const& dir);
   
   // This function does the following:
   // 1) Create a shader program object if one doesn't exist
@@ -86,6 +100,9 @@ public:
   // If the shader objects did not link into a program object, then the
   // member function must retrieve and write the program object's information
   // log to data member log_string. 
+  // After a successful link, every active uniform and uniform block is
+  // reflected into hashed tables that the uniform functions below read
+  // instead of querying the driver.
   GLboolean Link();
 
   // Install the shader program object whose handle is encapsulated
@@ -152,6 +169,54 @@ public:
   void SetUniform(GLchar const *name, glm::mat3 const& val);
   void SetUniform(GLchar const *name, glm::mat4 const& val);
 
+  // Active uniform as reflected by Link(). Uniforms of the default block
+  // have a location; members of uniform blocks have location -1 and are
+  // written to a uniform buffer at their offset and strides instead.
+  struct UniformInfo {
+    GLint location;
+    GLenum type;
+    GLint size;          // array elements from this one on - 1 if not an array
+    GLint block;         // index of the uniform block - -1 for default block
+    GLint offset;        // byte offset in the uniform block
+    GLint array_stride;  // bytes between elements of an array
+    GLint matrix_stride; // bytes between columns of a matrix
+  };
+  // Active uniform block as reflected by Link().
+  struct UniformBlockInfo {
+    GLuint index;
+    GLint data_size;     // bytes of buffer storage needed by the block
+    GLint binding;       // uniform buffer binding point read by the block
+  };
+
+  // Handle to active uniform "name" in the default block: -1 if there is no
+  // such uniform. Look a handle up once (for example, when an object is
+  // created) and pass it to the handle-based SetUniform() overloads below,
+  // which neither hash a name nor query the driver.
+  GLint GetUniformHandle(std::string const& name) const;
+
+  // reflected information about an active uniform or uniform block - or
+  // nullptr if there is no such active uniform or block
+  UniformInfo const* GetUniformInfo(std::string const& name) const;
+  UniformBlockInfo const* GetUniformBlockInfo(std::string const& name) const;
+
+  // make uniform block "name" read the buffer bound to uniform buffer
+  // binding point "binding"
+  GLboolean BindUniformBlock(std::string const& name, GLuint binding);
+
+  // The same family of functions taking a handle returned by
+  // GetUniformHandle(). A handle of -1 is silently ignored, as OpenGL does.
+  void SetUniform(GLint handle, GLboolean val);
+  void SetUniform(GLint handle, GLint val);
+  void SetUniform(GLint handle, GLfloat val);
+  void SetUniform(GLint handle, GLfloat x, GLfloat y);
+  void SetUniform(GLint handle, GLfloat x, GLfloat y, GLfloat z);
+  void SetUniform(GLint handle, GLfloat x, GLfloat y, GLfloat z, GLfloat w);
+  void SetUniform(GLint handle, glm::vec2 const& val);
+  void SetUniform(GLint handle, glm::vec3 const& val);
+  void SetUniform(GLint handle, glm::vec4 const& val);
+  void SetUniform(GLint handle, glm::mat3 const& val);
+  void SetUniform(GLint handle, glm::mat4 const& val);
+
   // display the list of active vertex attributes used by vertex shader
   void PrintActiveAttribs() const;
 
@@ -173,14 +238,36 @@ private:
   GLuint pgm_handle = 0;  // handle to linked shader program object
   GLboolean is_linked = GL_FALSE; // has the program successfully linked?
   std::string log_string; // log for OpenGL compiler and linker messages
+  // active uniforms and uniform blocks by name, filled by Link()
+  std::unordered_map<std::string, UniformInfo> uniforms;
+  std::unordered_map<std::string, UniformBlockInfo> uniform_blocks;
+  static std::string binary_cache_dir; // see SetBinaryCacheDirectory()
 
 private:
-  // use OpenGL API to return the location of an uniform variable with
-  // name "name" using program handle encapsulated by object of this class type
+  // return the location of an uniform variable with name "name" from the
+  // table of active uniforms built by Link()
   GLint GetUniformLocation(GLchar const *name);
+
+  // query the active uniforms and uniform blocks of the linked program
+  void ReflectUniforms();
   
   // return true if file (given in relative path) exists, false otherwise
   GLboolean FileExists(std::string const& file_name);
+
+  // read the contents of shader file "file_name" into "shader_src"
+  GLboolean ReadShaderFile(std::string const& file_name, std::string& shader_src);
+
+  // pathname of the cached binary with key "key" - empty if the cache is
+  // disabled or the driver supports no binary formats
+  static std::string BinaryCachePath(std::uint64_t key);
+
+  // create the program from the cached binary in file "path" - returns
+  // GL_FALSE, leaving no program object behind, if the file doesn't hold a
+  // binary with key "key" that the driver accepts
+  GLboolean LoadProgramBinary(std::string const& path, std::uint64_t key);
+
+  // write the binary of the linked program and its key to file "path"
+  void SaveProgramBinary(std::string const& path, std::uint64_t key) const;
 };
 
 #endif /* GLSLSHADER_H */
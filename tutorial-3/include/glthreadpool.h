@@ -0,0 +1,47 @@
+/* !
+@file		glthreadpool.h
+@author		benjaminzhiyuan.lee@digipen.edu
+@date		17/10/2026
+
+This file contains the declaration of structure GLThreadPool that encapsulates
+a fixed set of worker threads used by the application to spread data-parallel
+work (such as updating the transforms of objects) across every core of the
+machine.
+
+*//*__________________________________________________________________________*/
+
+/*                                                                      guard
+----------------------------------------------------------------------------- */
+#ifndef GLTHREADPOOL_H
+#define GLTHREADPOOL_H
+
+/*                                                                   includes
+----------------------------------------------------------------------------- */
+#include <GL/glew.h> // for GLuint
+#include <functional>
+
+/*  _________________________________________________________________________ */
+struct GLThreadPool
+  /*! GLThreadPool structure to encapsulate worker threads that are spawned
+  once by init() and then sleep until parallel_for() hands them a job.
+  */
+{
+  // spawn thread_cnt - 1 worker threads - the thread calling parallel_for()
+  // always participates as the last worker. A thread_cnt of 0 uses the
+  // number of hardware threads reported by std::thread ...
+  static void init(GLuint thread_cnt = 0);
+  static void cleanup();
+
+  // invoke job(index, worker) for every index in range [0, count) and return
+  // only after every invocation has completed. Indices are handed out one at
+  // a time so that threads that finish early pick up the remaining work.
+  // Parameter worker is in range [0, size()) and identifies the thread that
+  // executes the invocation - use it to index per-thread scratch storage.
+  static void parallel_for(GLuint count,
+    std::function<void(GLuint index, GLuint worker)> const& job);
+
+  // number of threads (including the caller) that execute parallel_for()
+  static GLuint size();
+};
+
+#endif /* GLTHREADPOOL_H */
@@ -21,22 +21,38 @@ to OpenGL implementations.
 #include <random>
 #include <glapp.h>
 #include <glhelper.h>
+#include <glthreadpool.h>
 #include <array>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
 #include <glm/gtc/type_ptr.hpp>
 
+// SSE2 is part of every x64 target and of x86 targets built with /arch:SSE2
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GLAPP_SSE2 1
+#include <emmintrin.h>
+#endif
+
 // define singleton containers
 std::vector<GLSLShader> GLApp::shdrpgms;
 std::vector<GLApp::GLModel> GLApp::models;
-std::list<GLApp::GLObject> GLApp::objects;
+GLApp::GLObjects GLApp::objects;
+GLApp::GLInstanceBuffer GLApp::instances{};
 
 //static variables
-static int box_count = 0,	 //number of boxes
+static size_t box_count = 0,	 //number of boxes
 mystery_count = 0,			//number of mystery objects
 increase_count = 0,		   //number of objects to spawn
 decrease_count = 0;		  //number of objects to kill
 
 static GLboolean spawn_mode = true; //spawn_mode true = spawn objects, false = kill objects
 
+//maximum number of spawned objects - all objects of a model are drawn by a
+//single instanced draw call, so the limit is set by memory rather than by
+//the number of draw calls
+static size_t const max_objects = 1 << 20;
+
 //enumaration for raster mode
 enum mode
 {
@@ -48,11 +64,129 @@ enum mode
 //store current raster mode
 static mode raster = fill;
 
+//number of objects updated by one job of the thread pool - large enough for
+//the cost of handing out a job to vanish, small enough to balance the load
+static size_t const update_batch = 4096;
+
+/**
+
+@brief Computes the sine and cosine of 4 angles at once.
+
+With SSE2, the angles are reduced to [-pi/4, pi/4] by Cody-Waite reduction and the sine and
+
+cosine are evaluated by the minimax polynomials of the Cephes library's sinf and cosf, which are
+
+accurate to a few ulp for angles of magnitude up to 8192. Otherwise std::sin and std::cos are used.
+
+@param a The 4 angles in radians.
+
+@param s The 4 sines.
+
+@param c The 4 cosines.
+*/
+static void sincos4(float const* a, float* s, float* c)
+{
+#ifdef GLAPP_SSE2
+	__m128 const sign_mask = _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(0x80000000u)));
+	__m128 x = _mm_loadu_ps(a);
+	__m128 sign_sin = _mm_and_ps(x, sign_mask);
+	x = _mm_andnot_ps(sign_mask, x);
+
+	//octant of |x| rounded up to an even number: j = (int(x * 4/pi) + 1) & ~1
+	__m128i j = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(1.27323954473516f)));
+	j = _mm_and_si128(_mm_add_epi32(j, _mm_set1_epi32(1)), _mm_set1_epi32(~1));
+	__m128 y = _mm_cvtepi32_ps(j);
+
+	//octants 4 to 7 flip the sine, octants 2 to 5 flip the cosine and
+	//octants 2, 3, 6 and 7 swap the two polynomials
+	sign_sin = _mm_xor_ps(sign_sin, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, _mm_set1_epi32(4)), 29)));
+	__m128 sign_cos = _mm_castsi128_ps(_mm_slli_epi32(
+		_mm_andnot_si128(_mm_sub_epi32(j, _mm_set1_epi32(2)), _mm_set1_epi32(4)), 29));
+	__m128 poly_mask = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, _mm_set1_epi32(2)), _mm_setzero_si128()));
+
+	//x - y * pi/4 in three parts to keep the bits of x
+	x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(0.78515625f)));
+	x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(2.4187564849853515625e-4f)));
+	x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(3.77489497744594108e-8f)));
+	__m128 z = _mm_mul_ps(x, x);
+
+	//cosine polynomial
+	__m128 yc = _mm_set1_ps(2.443315711809948e-5f);
+	yc = _mm_add_ps(_mm_mul_ps(yc, z), _mm_set1_ps(-1.388731625493765e-3f));
+	yc = _mm_add_ps(_mm_mul_ps(yc, z), _mm_set1_ps(4.166664568298827e-2f));
+	yc = _mm_mul_ps(_mm_mul_ps(yc, z), z);
+	yc = _mm_add_ps(_mm_sub_ps(yc, _mm_mul_ps(z, _mm_set1_ps(0.5f))), _mm_set1_ps(1.f));
+
+	//sine polynomial
+	__m128 ys = _mm_set1_ps(-1.9515295891e-4f);
+	ys = _mm_add_ps(_mm_mul_ps(ys, z), _mm_set1_ps(8.3321608736e-3f));
+	ys = _mm_add_ps(_mm_mul_ps(ys, z), _mm_set1_ps(-1.6666654611e-1f));
+	ys = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(ys, z), x), x);
+
+	__m128 sin_poly = _mm_or_ps(_mm_and_ps(poly_mask, ys), _mm_andnot_ps(poly_mask, yc));
+	__m128 cos_poly = _mm_or_ps(_mm_and_ps(poly_mask, yc), _mm_andnot_ps(poly_mask, ys));
+	_mm_storeu_ps(s, _mm_xor_ps(sin_poly, sign_sin));
+	_mm_storeu_ps(c, _mm_xor_ps(cos_poly, sign_cos));
+#else
+	for (int k = 0; k < 4; ++k)
+	{
+		s[k] = std::sin(a[k]);
+		c[k] = std::cos(a[k]);
+	}
+#endif
+}
+
 /**
 
-@brief Initializes the GLObject.
+@brief Returns the number of objects.
+*/
+size_t GLApp::GLObjects::size() const
+{
+	return position.size();
+}
 
-This function initializes the GLObject by setting various parameters such as the model reference,
+/**
+
+@brief Spawns objects.
+
+Every array grows by count elements at once and the new objects are then initialized
+
+in place, so spawning is a few bulk allocations rather than one per object.
+
+@param count The number of objects to spawn.
+
+@return The dense index of the first new object.
+*/
+size_t GLApp::GLObjects::spawn(size_t count)
+{
+	size_t first = size();
+	for_each_array([first, count](auto& array) { array.resize(first + count); });
+	for (size_t i = first; i < first + count; ++i)
+	{
+		init(i);
+	}
+	return first;
+}
+
+/**
+
+@brief Kills the oldest objects.
+
+Each array is shifted down by count elements in a single move of the elements that remain.
+
+@param count The number of objects to kill.
+*/
+void GLApp::GLObjects::kill_front(size_t count)
+{
+	count = std::min(count, size());
+	for_each_array([count](auto& array) { array.erase(array.begin(), array.begin() + count); });
+}
+
+/**
+
+@brief Initializes an object.
+
+This function initializes an object by setting various parameters such as the model reference,
 
 shader reference, position, scaling, rotation speed, and current orientation.
 
@@ -67,133 +201,129 @@ The scaling is randomly set between 0.05 and 0.15 on both x and y axes.
 The rotation speed is randomly set between -1 and 1.
 
 The current orientation is calculated by multiplying a random value between -1 and 1 with 360.
+
+The color is a random tint with channels between 0.25 and 1 that multiplies the vertex colors of the model,
+
+so that objects sharing a model can be told apart.
 */
-void GLApp::GLObject::init()
+void GLApp::GLObjects::init(size_t i)
 {
 	/*double const range_x = GLHelper::width;
 	double const range_y = GLHelper::height;*/
 
 	//randomly choose 0 or 1 to decide which model data is assigned to mdl_ref
-	std::random_device ran;
-	std::mt19937 mystery(ran());
+	//the engine is seeded once: seeding it for every object is what limited
+	//how fast objects could be spawned
+	static std::mt19937 mystery(std::random_device{}());
 	std::uniform_int_distribution<> dis(0, 1);
-	mdl_ref = dis(mystery);
+	mdl_ref[i] = dis(mystery);
 
 	//assign shd_ref value of 0
-	shd_ref = 0;
+	shd_ref[i] = 0;
+
+	//random tint, kept bright enough for the model's vertex colors to show
+	std::uniform_real_distribution<float> dis_tint(0.25f, 1.f);
+	color[i] = glm::vec3(dis_tint(mystery), dis_tint(mystery), dis_tint(mystery));
 
 	//init the objects parameters
 	std::uniform_real_distribution<> dis_float(-1.f, 1.f);
 
 	//set random position between -1.f and 1.f
 	std::uniform_real_distribution<> dis_coordinate(-1.f, 1.f);
-	position = glm::vec2(dis_coordinate(mystery), dis_coordinate(mystery));
+	position[i] = glm::vec2(dis_coordinate(mystery), dis_coordinate(mystery));
 
 	//Initialise objects scale, rotation
 	std::uniform_real_distribution<> dis_scale(0.05, 0.15);		//random scale
-	scaling = glm::vec2(dis_scale(mystery), dis_scale(mystery));
-	angle_speed = static_cast<float>(dis_float(mystery));			//random rotation speed
-	angle_disp = static_cast<float>(dis_float(mystery)) * 360.f;	//current orientation
+	scaling[i] = glm::vec2(dis_scale(mystery), dis_scale(mystery));
+	angle_speed[i] = static_cast<float>(dis_float(mystery));			//random rotation speed
+	angle_disp[i] = static_cast<float>(dis_float(mystery)) * 360.f;	//current orientation
 }
 
 /**
 
-@brief Draws the GLObject.
-
-This function performs the necessary steps to draw the GLObject on the screen.
-
-It installs the shader program, binds the object's vertex array object (VAO), and copies the object's
-
-transformation matrix to the vertex shader. Then, based on the specified raster mode, it renders the model
+@brief Updates the objects.
 
-using the appropriate OpenGL draw function (glDrawArrays). Finally, it cleans up by unbinding the VAO and
-
-unusing the shader program.
-*/
-void GLApp::GLObject::draw() const
-{
-	//install shader prgm
-	shdrpgms[shd_ref].Use();
-
-	//bind object vao handle
-	glBindVertexArray(models[mdl_ref].vaoid);
-
-	//copy object 3x3 model to ndc matrix to vtx shader
-	GLint uniform_var_loc1 =
-		glGetUniformLocation(GLApp::shdrpgms[shd_ref].GetHandle(),
-			"uModel_to_NDC");
-	if (uniform_var_loc1 >= 0) {
-		// Print the matrix elements
-		const glm::mat3& matrix = GLApp::GLObject::mdl_to_ndc_xform;
-
-		glUniformMatrix3fv(uniform_var_loc1, 1, GL_FALSE,
-			glm::value_ptr(matrix));
-	}
-	else {
-		std::cout << "Uniform variable doesn't exist!!!\n";
-		std::exit(EXIT_FAILURE);
-	}
-
-	//render model
-	switch (raster)
-	{
-	case line:
-		glLineWidth(10.f);
-		glDrawArrays(models[mdl_ref].primitive_type, 0, models[mdl_ref].draw_cnt);
-		glLineWidth(1.f);
-		break;
-	case fill:
-		glDrawArrays(models[mdl_ref].primitive_type, 0, models[mdl_ref].draw_cnt);
-		break;
-	case point:
-		glPointSize(10.f);
-		glDrawArrays(models[mdl_ref].primitive_type, 0, models[mdl_ref].draw_cnt);
-		glPointSize(1.f);
-		break;
-	}
-	
-	//cleanup
-	glBindVertexArray(0);
-	shdrpgms[shd_ref].UnUse();
-}
+This function updates every object by modifying its orientation based on the provided delta time.
 
-/**
+For each object, it calculates the new angle displacement by adding the product of angle speed and delta time to the
 
-@brief Updates the GLObject.
+current angle displacement, which is kept in [-pi, pi]. The model-to-NDC transformation matrix is then built directly
 
-This function updates the GLObject by modifying its orientation based on the provided delta time.
+as translation * rotation * scale, i.e. the columns of the rotation scaled by the object's scaling followed by its position,
 
-It calculates the new angle displacement by adding the product of angle speed and delta time to the
+and written together with the object's color to the object's slot in dst.
 
-current angle displacement. Then, it calculates the translation matrix, rotation matrix, and scale matrix
+The objects are split into batches of update_batch objects that the thread pool updates in parallel. A first pass counts
 
-based on the object's position, angle displacement, and scaling values. Finally, it combines these matrices
+the objects of every group in every batch, so that each batch knows where its objects of each group go and the batches
 
-to calculate the model-to-NDC transformation matrix (mdl_to_ndc_xform).
+can write to dst without synchronizing; the sines and cosines are computed 4 objects at a time by sincos4().
 
 @param delta_time The time difference between the current frame and the previous frame.
+
+@param dst The instance attributes of all objects, grouped by model and shader program.
 */
-void GLApp::GLObject::update(GLdouble delta_time)
+void GLApp::GLObjects::update(GLdouble delta_time, GLInstance* dst)
 {
-	//update object orientation
-	angle_disp += static_cast<float>(angle_speed * delta_time);
-
-	//translation matrix
-	glm::mat3 transmtx = glm::mat3(1.f);
-	transmtx[2] = glm::vec3(position.x, position.y, 1.f);
+	size_t const group_cnt = models.size() * shdrpgms.size();
+	size_t const batch_cnt = (size() + update_batch - 1) / update_batch;
+
+	//pass 1: count the objects of each group in each batch
+	std::vector<GLuint> next(batch_cnt * group_cnt, 0);
+	GLThreadPool::parallel_for(static_cast<GLuint>(batch_cnt), [&](GLuint batch, GLuint) {
+		GLuint* count = next.data() + batch * group_cnt;
+		for (size_t i = batch * update_batch; i < std::min(size(), (batch + 1) * update_batch); ++i)
+		{
+			++count[mdl_ref[i] * shdrpgms.size() + shd_ref[i]];
+		}
+	});
 
-	//rotation matrix
-	glm::mat3 rotmtx = glm::mat3(1.f);
-	rotmtx[0] = glm::vec3(std::cos(angle_disp), -std::sin(angle_disp), 0.f);
-	rotmtx[1] = glm::vec3(std::sin(angle_disp), std::cos(angle_disp), 0.f);
+	//turn the counts into the first slot of each group in each batch
+	group_first.assign(group_cnt + 1, 0);
+	GLuint slot = 0;
+	for (size_t g = 0; g < group_cnt; ++g)
+	{
+		group_first[g] = slot;
+		for (size_t batch = 0; batch < batch_cnt; ++batch)
+		{
+			GLuint count = next[batch * group_cnt + g];
+			next[batch * group_cnt + g] = slot;
+			slot += count;
+		}
+	}
+	group_first[group_cnt] = slot;
+
+	//pass 2: update the objects of each batch and write their instances
+	float const dt = static_cast<float>(delta_time);
+	float const pi = 3.14159265358979f;
+	GLThreadPool::parallel_for(static_cast<GLuint>(batch_cnt), [&](GLuint batch, GLuint) {
+		GLuint* slots = next.data() + batch * group_cnt;
+		size_t const end = std::min(size(), (batch + 1) * update_batch);
+		for (size_t i = batch * update_batch; i < end; i += 4)
+		{
+			size_t const n = std::min<size_t>(4, end - i);
 
-	//scale matrix
-	glm::mat3 scalmtx = glm::mat3(1.f);
-	scalmtx[0][0] = scaling.x;
-	scalmtx[1][1] = scaling.y;
+			//update object orientation
+			float a[4] = {}, s[4], c[4];
+			for (size_t k = 0; k < n; ++k)
+			{
+				float angle = angle_disp[i + k] + angle_speed[i + k] * dt;
+				angle_disp[i + k] = a[k] = angle - 2.f * pi * std::floor((angle + pi) / (2.f * pi));
+			}
+			sincos4(a, s, c);
 
-	//perform transform calculations
-	mdl_to_ndc_xform = transmtx * rotmtx * scalmtx;
+			//translation * rotation * scale
+			for (size_t k = 0; k < n; ++k)
+			{
+				size_t const o = i + k;
+				GLInstance& inst = dst[slots[mdl_ref[o] * shdrpgms.size() + shd_ref[o]]++];
+				inst.mdl_to_ndc_xform[0] = glm::vec3(c[k] * scaling[o].x, -s[k] * scaling[o].x, 0.f);
+				inst.mdl_to_ndc_xform[1] = glm::vec3(s[k] * scaling[o].y, c[k] * scaling[o].y, 0.f);
+				inst.mdl_to_ndc_xform[2] = glm::vec3(position[o].x, position[o].y, 1.f);
+				inst.color = color[o];
+			}
+		}
+	});
 }
 
 /*	
@@ -227,6 +357,9 @@ void GLApp::init() {
 	GLApp::init_shdrpgms_cont(shdr_file_names);
 
 	GLApp::init_models_cont();
+
+// Part 5: start the worker threads that update the objects
+	GLThreadPool::init();
 }
 
 /*	update
@@ -259,29 +392,24 @@ void GLApp::update() {
 
 	if (GLHelper::mousestateLeft == GLFW_TRUE)
 	{
-		GLint max_size;
-		glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size); //maximum spawned objects
 		// If maximum object limit is not reached, spawn new object(s)
 		
-		if (static_cast<GLint>(objects.size() * 2) <= max_size && spawn_mode)
+		if (objects.size() * 2 <= max_objects && spawn_mode)
 		{
-			increase_count = objects.size(); //increase amount = objects size
+			increase_count = std::max<size_t>(objects.size(), 1); //increase amount = objects size
 
-			for (int i = 0; i < increase_count || objects.size() == 0; ++i)
+			//Add objects
+			size_t first = objects.spawn(increase_count);
+			for (size_t i = first; i < objects.size(); ++i)
 			{
-				//Add objects
-				GLObject newobj{};
-				newobj.init();
-				
-				if (newobj.mdl_ref == 0) //if its a box, ++count of box
+				if (objects.mdl_ref[i] == 0) //if its a box, ++count of box
 				{
 					box_count++;
 				}
-				else if (newobj.mdl_ref == 1) //else ++ count of mystery
+				else if (objects.mdl_ref[i] == 1) //else ++ count of mystery
 				{
 					mystery_count++;
 				}
-				objects.emplace_back(newobj);
 			}
 		}
 		// Otherwise, kill oldest objects
@@ -290,9 +418,9 @@ void GLApp::update() {
 			spawn_mode = false;						
 			decrease_count = objects.size() / 2;	//delete half of total objects
 			
-			for (int i = 0; i < decrease_count; ++i)
+			for (size_t i = 0; i < decrease_count; ++i)
 			{
-				if (objects.front().mdl_ref == 0)	//if its a box, decrease box count
+				if (objects.mdl_ref[i] == 0)	//if its a box, decrease box count
 				{
 					box_count--;
 				}
@@ -300,24 +428,14 @@ void GLApp::update() {
 				{
 					mystery_count--;
 				}
-				objects.pop_front();				//erase object from front of object list
 			}
+			objects.kill_front(decrease_count);	//erase oldest objects from front of object arrays
 		}
 
 		if (objects.size() == 1) //if only 1 object remains, change back to spawn objects
 		{
 			spawn_mode = true;
 		}
-
-		//ensure count does not go to negative
-		if (mystery_count < 0) 
-		{
-			mystery_count = 0;
-		}
-		if (box_count < 0)
-		{
-			box_count = 0;
-		}
 		GLHelper::mousestateLeft = GLFW_RELEASE;
 	}
 
@@ -327,10 +445,9 @@ void GLApp::update() {
 	// A more elaborate implementation would animate the object's movement
 	// A much more elaborate implementation would animate the object's size
 	// Using updated attributes, compute world-to-ndc transformation matrix
-	for (auto& object : objects) 
-	{
-		object.update(GLHelper::delta_time);
-	}
+	// and write it straight into this frame's region of the instance buffer
+	instances.reserve(static_cast<GLuint>(objects.size()));
+	objects.update(GLHelper::delta_time, instances.begin_frame());
 }
 
 
@@ -371,14 +488,149 @@ void GLApp::draw()
 		break;
 	}
 
-	// Part 4: Render each object in container GLApp::objects
-	for (auto const& x : GLApp::objects) {
-		x.draw(); // call member function GLObject::draw()
+	// Part 4: Render the objects in container GLApp::objects
+	// Objects are grouped by model and shader program: update() packed the
+	// instance attributes of each group contiguously into the instance
+	// buffer and the group is drawn by a single instanced draw call
+	std::vector<GLuint> const& first = objects.group_first;
+	size_t const group_cnt = first.empty() ? 0 : first.size() - 1;
+	for (size_t g = 0; g < group_cnt; ++g) {
+		GLsizei count = static_cast<GLsizei>(first[g + 1] - first[g]);
+		if (count == 0) {
+			continue;
+		}
+		GLApp::GLModel const& mdl = models[g / shdrpgms.size()];
+		GLSLShader& shdr_pgm = shdrpgms[g % shdrpgms.size()];
+
+		//install shader prgm and bind the model's vao, which reads the
+		//instance attributes of the group from the current region
+		shdr_pgm.Use();
+		glVertexArrayVertexBuffer(mdl.vaoid, instance_binding, instances.bufid,
+			instances.offset(first[g]), sizeof(GLInstance));
+		glBindVertexArray(mdl.vaoid);
+
+		//render model
+		switch (raster)
+		{
+		case line:
+			glLineWidth(10.f);
+			glDrawArraysInstanced(mdl.primitive_type, 0, mdl.draw_cnt, count);
+			glLineWidth(1.f);
+			break;
+		case fill:
+			glDrawArraysInstanced(mdl.primitive_type, 0, mdl.draw_cnt, count);
+			break;
+		case point:
+			glPointSize(10.f);
+			glDrawArraysInstanced(mdl.primitive_type, 0, mdl.draw_cnt, count);
+			glPointSize(1.f);
+			break;
+		}
+
+		//cleanup
+		glBindVertexArray(0);
+		shdr_pgm.UnUse();
 	}
+	instances.end_frame();
 }
 
 void GLApp::cleanup() {
-	// empty for now
+	instances.destroy();
+	GLThreadPool::cleanup();
+}
+
+/**
+
+@brief Grows the regions of the instance buffer.
+
+A buffer object with immutable storage cannot be resized, so a new buffer
+is created and mapped for as long as the application runs. The capacity at
+least doubles every time so that spawning objects reallocates rarely.
+
+@param count The number of instances each region must hold.
+*/
+void GLApp::GLInstanceBuffer::reserve(GLuint count)
+{
+	if (bufid != 0 && count <= capacity) {
+		return;
+	}
+	destroy();
+	capacity = std::max({ count, capacity * 2, 1024u });
+
+	GLbitfield const flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	GLsizeiptr const size = static_cast<GLsizeiptr>(sizeof(GLInstance)) * capacity * region_cnt;
+	glCreateBuffers(1, &bufid);
+	glNamedBufferStorage(bufid, size, nullptr, flags);
+	mapped = static_cast<GLInstance*>(glMapNamedBufferRange(bufid, 0, size, flags));
+	if (mapped == nullptr) {
+		std::cout << "Unable to map instance buffer\n";
+		std::exit(EXIT_FAILURE);
+	}
+	region = 0;
+}
+
+/**
+
+@brief Moves on to the next region of the instance buffer.
+
+Because the mapping is coherent, values written to the region are seen by
+draw calls issued afterwards without any flush.
+
+@return The first instance of the region.
+*/
+GLApp::GLInstance* GLApp::GLInstanceBuffer::begin_frame()
+{
+	region = (region + 1) % region_cnt;
+	if (fences[region] != nullptr) {
+		while (glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {
+		}
+		glDeleteSync(fences[region]);
+		fences[region] = nullptr;
+	}
+	return mapped + static_cast<size_t>(region) * capacity;
+}
+
+/**
+
+@brief Returns the byte offset of an instance of the current region.
+
+@param i The index of the instance in the region.
+*/
+GLintptr GLApp::GLInstanceBuffer::offset(GLuint i) const
+{
+	return static_cast<GLintptr>(sizeof(GLInstance)) * (static_cast<GLintptr>(region) * capacity + i);
+}
+
+/**
+
+@brief Fences the current region after the draw calls that read it.
+*/
+void GLApp::GLInstanceBuffer::end_frame()
+{
+	fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+/**
+
+@brief Unmaps and deletes the instance buffer.
+
+Deleting a buffer the GPU still reads is safe: OpenGL keeps its storage
+until the commands that use it have completed.
+*/
+void GLApp::GLInstanceBuffer::destroy()
+{
+	for (GLsync& fence : fences) {
+		if (fence != nullptr) {
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+	}
+	if (bufid != 0) {
+		glUnmapNamedBuffer(bufid);
+		glDeleteBuffers(1, &bufid);
+	}
+	bufid = 0;
+	mapped = nullptr;
 }
 
 //rng for colours
@@ -557,10 +809,30 @@ GLApp::GLModel GLApp::mystery_model()
 This function adds the models generated by the box_model() and mystery_model() functions to the models
 
 vector of the GLApp. These models can then be used for rendering in the application.
+
+The VAO of every model is also set up to read the per-instance attributes of GLInstance from
+
+vertex buffer binding instance_binding, which draw() points at the instance buffer.
 */
 void GLApp::init_models_cont() {
 	GLApp::models.emplace_back(GLApp::box_model());
 	GLApp::models.emplace_back(GLApp::mystery_model());
+
+	for (GLApp::GLModel const& mdl : GLApp::models) {
+		// columns of the model-to-NDC transform at locations 2 to 4
+		for (GLuint col = 0; col < 3; ++col) {
+			glEnableVertexArrayAttrib(mdl.vaoid, 2 + col);
+			glVertexArrayAttribFormat(mdl.vaoid, 2 + col, 3, GL_FLOAT, GL_FALSE,
+				offsetof(GLInstance, mdl_to_ndc_xform) + col * sizeof(glm::vec3));
+			glVertexArrayAttribBinding(mdl.vaoid, 2 + col, instance_binding);
+		}
+		// color at location 5
+		glEnableVertexArrayAttrib(mdl.vaoid, 5);
+		glVertexArrayAttribFormat(mdl.vaoid, 5, 3, GL_FLOAT, GL_FALSE, offsetof(GLInstance, color));
+		glVertexArrayAttribBinding(mdl.vaoid, 5, instance_binding);
+		// advance once per instance rather than once per vertex
+		glVertexArrayBindingDivisor(mdl.vaoid, instance_binding, 1);
+	}
 }
 
 /**
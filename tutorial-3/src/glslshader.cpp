@@ -11,12 +11,151 @@ speak to me.
 This file contains definitions of member functions of class GLShader.
 Please see the class declaration for information about these functions.
 
+Program binaries are cached in files named after a 64-bit FNV-1a hash of the
+driver strings and of the type and source of every shader. The file repeats
+the hash and stores the binary format and length, so a binary written by a
+different driver, or a truncated file, is never handed to glProgramBinary.
+
 *//*__________________________________________________________________________*/
 #include <glslshader.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+  // header of a cached program binary - followed by length bytes of binary
+  struct BinaryHeader {
+    char magic[4];        // "GLPB"
+    std::uint64_t key;    // hash the file is named after
+    GLenum format;        // binary format returned by glGetProgramBinary
+    GLint length;         // bytes of binary
+  };
+  constexpr char binary_magic[4] = { 'G', 'L', 'P', 'B' };
+
+  // 64-bit FNV-1a hash of "size" bytes, continuing from hash "h"
+  std::uint64_t fnv1a(void const *data, size_t size,
+                      std::uint64_t h = 0xcbf29ce484222325ull) {
+    unsigned char const *bytes = static_cast<unsigned char const*>(data);
+    for (size_t i = 0; i < size; ++i) {
+      h = (h ^ bytes[i]) * 0x100000001b3ull;
+    }
+    return h;
+  }
+
+  // hash of the strings that identify the driver and of the shader sources
+  std::uint64_t program_key(std::vector<std::pair<GLenum, std::string>> const& sources) {
+    std::uint64_t h = fnv1a(nullptr, 0);
+    GLenum const names[] = { GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION };
+    for (GLenum name : names) {
+      GLubyte const *str = glGetString(name);
+      size_t len = str ? std::strlen(reinterpret_cast<char const*>(str)) : 0;
+      h = fnv1a(str, len, h);
+      h = fnv1a("", 1, h); // terminator - so that "ab"+"c" differs from "a"+"bc"
+    }
+    for (auto const& src : sources) {
+      std::uint64_t len = src.second.size();
+      h = fnv1a(&src.first, sizeof(src.first), h);
+      h = fnv1a(&len, sizeof(len), h);
+      h = fnv1a(src.second.data(), src.second.size(), h);
+    }
+    return h;
+  }
+}
+
+std::string GLSLShader::binary_cache_dir{ "." };
+
+void
+GLSLShader::SetBinaryCacheDirectory(std::string const& dir) {
+  binary_cache_dir = dir;
+}
 
 GLint
 GLSLShader::GetUniformLocation(GLchar const *name) {
-  return glGetUniformLocation(pgm_handle, name); 
+  auto it = uniforms.find(name);
+  return it == uniforms.end() ? -1 : it->second.location;
+}
+
+void
+GLSLShader::ReflectUniforms() {
+  uniforms.clear();
+  uniform_blocks.clear();
+
+  GLint num_uniforms = 0, max_length = 0;
+  glGetProgramiv(pgm_handle, GL_ACTIVE_UNIFORMS, &num_uniforms);
+  glGetProgramiv(pgm_handle, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+  std::vector<GLchar> pname(static_cast<size_t>(std::max(max_length, 1)));
+  for (GLint i = 0; i < num_uniforms; ++i) {
+    GLsizei written;
+    UniformInfo info{};
+    glGetActiveUniform(pgm_handle, i, max_length, &written, &info.size, &info.type, pname.data());
+    GLuint index = static_cast<GLuint>(i);
+    glGetActiveUniformsiv(pgm_handle, 1, &index, GL_UNIFORM_BLOCK_INDEX, &info.block);
+    glGetActiveUniformsiv(pgm_handle, 1, &index, GL_UNIFORM_OFFSET, &info.offset);
+    glGetActiveUniformsiv(pgm_handle, 1, &index, GL_UNIFORM_ARRAY_STRIDE, &info.array_stride);
+    glGetActiveUniformsiv(pgm_handle, 1, &index, GL_UNIFORM_MATRIX_STRIDE, &info.matrix_stride);
+    info.location = info.block < 0 ? glGetUniformLocation(pgm_handle, pname.data()) : -1;
+
+    // arrays are reported as "name[0]" - make them known by "name" and by
+    // "name[i]" for every element, so that any element can be set by name
+    std::string name(pname.data(), written);
+    uniforms[name] = info;
+    if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) {
+      std::string base = name.substr(0, name.size() - 3);
+      uniforms[base] = info;
+      for (GLint e = 1; e < info.size; ++e) {
+        UniformInfo elem = info;
+        std::string elem_name = base + "[" + std::to_string(e) + "]";
+        elem.size = info.size - e;
+        elem.offset = info.offset < 0 ? -1 : info.offset + e * info.array_stride;
+        elem.location = info.block < 0 ? glGetUniformLocation(pgm_handle, elem_name.c_str()) : -1;
+        uniforms[elem_name] = elem;
+      }
+    }
+  }
+
+  GLint num_blocks = 0;
+  glGetProgramiv(pgm_handle, GL_ACTIVE_UNIFORM_BLOCKS, &num_blocks);
+  glGetProgramiv(pgm_handle, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &max_length);
+  pname.resize(static_cast<size_t>(std::max(max_length, 1)));
+  for (GLint i = 0; i < num_blocks; ++i) {
+    GLsizei written;
+    GLuint index = static_cast<GLuint>(i);
+    glGetActiveUniformBlockName(pgm_handle, index, max_length, &written, pname.data());
+    UniformBlockInfo info{ index, 0, 0 };
+    glGetActiveUniformBlockiv(pgm_handle, index, GL_UNIFORM_BLOCK_DATA_SIZE, &info.data_size);
+    glGetActiveUniformBlockiv(pgm_handle, index, GL_UNIFORM_BLOCK_BINDING, &info.binding);
+    uniform_blocks[std::string(pname.data(), written)] = info;
+  }
+}
+
+GLint
+GLSLShader::GetUniformHandle(std::string const& name) const {
+  auto it = uniforms.find(name);
+  return it == uniforms.end() ? -1 : it->second.location;
+}
+
+GLSLShader::UniformInfo const*
+GLSLShader::GetUniformInfo(std::string const& name) const {
+  auto it = uniforms.find(name);
+  return it == uniforms.end() ? nullptr : &it->second;
+}
+
+GLSLShader::UniformBlockInfo const*
+GLSLShader::GetUniformBlockInfo(std::string const& name) const {
+  auto it = uniform_blocks.find(name);
+  return it == uniform_blocks.end() ? nullptr : &it->second;
+}
+
+GLboolean
+GLSLShader::BindUniformBlock(std::string const& name, GLuint binding) {
+  auto it = uniform_blocks.find(name);
+  if (it == uniform_blocks.end()) {
+    std::cout << "Uniform block " << name << " doesn't exist" << std::endl;
+    return GL_FALSE;
+  }
+  glUniformBlockBinding(pgm_handle, it->second.index, binding);
+  it->second.binding = static_cast<GLint>(binding);
+  return GL_TRUE;
 }
 
 GLboolean
@@ -33,17 +172,39 @@ GLSLShader::DeleteShaderProgram() {
 
 GLboolean
 GLSLShader::CompileLinkValidate(std::vector<std::pair<GLenum, std::string>> vec) {
+  // the sources are read even on a warm run: they are part of the key, so
+  // that editing a shader invalidates its cached binary
+  std::vector<std::pair<GLenum, std::string>> sources;
   for (auto& elem : vec) {
-    if (GL_FALSE == CompileShaderFromFile(elem.first, elem.second.c_str())) {
+    std::string shader_src;
+    if (GL_FALSE == ReadShaderFile(elem.second, shader_src)) {
       return GL_FALSE;
     }
+    sources.emplace_back(elem.first, std::move(shader_src));
   }
-  if (GL_FALSE == Link()) {
-    return GL_FALSE;
+
+  std::uint64_t key = program_key(sources);
+  std::string cache_path = BinaryCachePath(key);
+  GLboolean cached = !cache_path.empty() && LoadProgramBinary(cache_path, key);
+  if (GL_FALSE == cached) {
+    for (auto& elem : sources) {
+      if (GL_FALSE == CompileShaderFromString(elem.first, elem.second)) {
+        return GL_FALSE;
+      }
+    }
+    if (!cache_path.empty()) {
+      glProgramParameteri(pgm_handle, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    if (GL_FALSE == Link()) {
+      return GL_FALSE;
+    }
   }
   if (GL_FALSE == Validate()) {
     return GL_FALSE;
   }
+  if (GL_FALSE == cached && !cache_path.empty()) {
+    SaveProgramBinary(cache_path, key);
+  }
   PrintActiveAttribs();
   PrintActiveUniforms();
 
@@ -52,18 +213,20 @@ GLSLShader::CompileLinkValidate(std::vector<std::pair<GLenum, std::string>> vec)
 
 GLboolean
 GLSLShader::CompileShaderFromFile(GLenum shader_type, const std::string& file_name) {
+  // the program object is created by CompileShaderFromString()
+  std::string shader_src;
+  if (GL_FALSE == ReadShaderFile(file_name, shader_src)) {
+    return GL_FALSE;
+  }
+  return CompileShaderFromString(shader_type, shader_src);
+}
+
+GLboolean
+GLSLShader::ReadShaderFile(std::string const& file_name, std::string& shader_src) {
   if (GL_FALSE == FileExists(file_name)) {
     log_string = "File not found";
     return GL_FALSE;
   }
-  if (pgm_handle <= 0) {
-    pgm_handle = glCreateProgram();
-    if (0 == pgm_handle) {
-      log_string = "Cannot create program handle";
-      return GL_FALSE;
-    }
-  }
-
   std::ifstream shader_file(file_name, std::ifstream::in);
   if (!shader_file) {
     log_string = "Error opening file " + file_name;
@@ -72,7 +235,93 @@ GLSLShader::CompileShaderFromFile(GLenum shader_type, const std::string& file_na
   std::stringstream buffer;
   buffer << shader_file.rdbuf();
   shader_file.close();
-  return CompileShaderFromString(shader_type, buffer.str());
+  shader_src = buffer.str();
+  return GL_TRUE;
+}
+
+std::string
+GLSLShader::BinaryCachePath(std::uint64_t key) {
+  GLint num_formats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+  if (binary_cache_dir.empty() || num_formats <= 0) {
+    return std::string();
+  }
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.glbin",
+    static_cast<unsigned long long>(key));
+  return binary_cache_dir + "/" + name;
+}
+
+GLboolean
+GLSLShader::LoadProgramBinary(std::string const& path, std::uint64_t key) {
+  std::ifstream ifs(path, std::ios::binary);
+  BinaryHeader header{};
+  if (!ifs || !ifs.read(reinterpret_cast<char*>(&header), sizeof(header))
+      || std::memcmp(header.magic, binary_magic, sizeof(binary_magic)) != 0
+      || header.key != key || header.length <= 0) {
+    return GL_FALSE;
+  }
+  std::vector<char> binary(static_cast<size_t>(header.length));
+  if (!ifs.read(binary.data(), header.length)) {
+    return GL_FALSE;
+  }
+
+  if (pgm_handle <= 0) {
+    pgm_handle = glCreateProgram();
+    if (0 == pgm_handle) {
+      return GL_FALSE;
+    }
+  }
+  glProgramBinary(pgm_handle, header.format, binary.data(), header.length);
+  // the driver may reject a binary it wrote, e.g. after an update that left
+  // the version string unchanged - the caller then compiles from source
+  GLint status = GL_FALSE;
+  glGetProgramiv(pgm_handle, GL_LINK_STATUS, &status);
+  if (GL_FALSE == status) {
+    glDeleteProgram(pgm_handle);
+    pgm_handle = 0;
+    return GL_FALSE;
+  }
+  ReflectUniforms();
+  return is_linked = GL_TRUE;
+}
+
+void
+GLSLShader::SaveProgramBinary(std::string const& path, std::uint64_t key) const {
+  GLint length = 0;
+  glGetProgramiv(pgm_handle, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) {
+    return;
+  }
+  std::vector<char> binary(static_cast<size_t>(length));
+  BinaryHeader header{};
+  std::memcpy(header.magic, binary_magic, sizeof(binary_magic));
+  header.key = key;
+  glGetProgramBinary(pgm_handle, length, &header.length, &header.format, binary.data());
+  if (header.length <= 0) {
+    return;
+  }
+
+  // write to a temporary file first so that another instance of the program
+  // never reads a partly written binary
+  std::string tmp_path = path + ".tmp";
+  {
+    std::ofstream ofs(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!ofs) {
+      return;
+    }
+    ofs.write(reinterpret_cast<char const*>(&header), sizeof(header));
+    ofs.write(binary.data(), header.length);
+    if (!ofs) {
+      ofs.close();
+      std::remove(tmp_path.c_str());
+      return;
+    }
+  }
+  std::remove(path.c_str());
+  if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+    std::remove(tmp_path.c_str());
+  }
 }
 
 GLboolean
@@ -154,6 +403,7 @@ GLboolean GLSLShader::Link() {
     }
     return GL_FALSE;
   }
+  ReflectUniforms();
   return is_linked = GL_TRUE;
 }
 
@@ -214,7 +464,7 @@ void GLSLShader::BindFragDataLocation(GLuint color_number, GLchar const *name) {
 }
 
 void GLSLShader::SetUniform(GLchar const *name, GLboolean val) {
-  GLint loc = glGetUniformLocation(pgm_handle, name);
+  GLint loc = GetUniformLocation(name);
   if (loc >= 0) {
     glUniform1i(loc, val);
   }
@@ -224,7 +474,7 @@ void GLSLShader::SetUniform(GLchar const *name, GLboolean val) {
 }
 
 void GLSLShader::SetUniform(GLchar const *name, GLint val) {
-  GLint loc = glGetUniformLocation(pgm_handle, name);
+  GLint loc = GetUniformLocation(name);
   if (loc >= 0) {
     glUniform1i(loc, val);
   }
@@ -234,7 +484,7 @@ void GLSLShader::SetUniform(GLchar const *name, GLint val) {
 }
 
 void GLSLShader::SetUniform(GLchar const *name, GLfloat val) {
-  GLint loc = glGetUniformLocation(pgm_handle, name);
+  GLint loc = GetUniformLocation(name);
   if (loc >= 0) {
     glUniform1f(loc, val);
   }
@@ -244,7 +494,7 @@ void GLSLShader::SetUniform(GLchar const *name, GLfloat val) {
 }
 
 void GLSLShader::SetUniform(GLchar const *name, GLfloat x, GLfloat y) {
-  GLint loc = glGetUniformLocation(pgm_handle, name);
+  GLint loc = GetUniformLocation(name);
   if (loc >= 0) {
     glUniform2f(loc, x, y);
   } else {
@@ -253,7 +503,7 @@ void GLSLShader::SetUniform(GLchar const *name, GLfloat x, GLfloat y) {
 }
 
 void GLSLShader::SetUniform(GLchar const *name, GLfloat x, GLfloat y, GLfloat z) {
-  GLint loc = glGetUniformLocation(pgm_handle, name);
+  GLint loc = GetUniformLocation(name);
   if (loc >= 0) {
     glUniform3f(loc, x, y, z);
   }
@@ -264,7 +514,7 @@ void GLSLShader::SetUniform(GLchar const *name, GLfloat x, GLfloat y, GLfloat z)
 
 void 
 GLSLShader::SetUniform(GLchar const *name, GLfloat x, GLfloat y, GLfloat z, GLfloat w) {
-  GLint loc = glGetUniformLocation(pgm_handle, name);
+  GLint loc = GetUniformLocation(name);
   if (loc >= 0) {
     glUniform4f(loc, x, y, z, w);
   } else {
@@ -273,7 +523,7 @@ GLSLShader::SetUniform(GLchar const *name, GLfloat x, GLfloat y, GLfloat z, GLfl
 }
 
 void GLSLShader::SetUniform(GLchar const *name, glm::vec2 const& val) {
-  GLint loc = glGetUniformLocation(pgm_handle, name);
+  GLint loc = GetUniformLocation(name);
   if (loc >= 0) {
     glUniform2f(loc, val.x, val.y);
   }
@@ -283,7 +533,7 @@ void GLSLShader::SetUniform(GLchar const *name, glm::vec2 const& val) {
 }
 
 void GLSLShader::SetUniform(GLchar const *name, glm::vec3 const& val) {
-  GLint loc = glGetUniformLocation(pgm_handle, name);
+  GLint loc = GetUniformLocation(name);
   if (loc >= 0) {
     glUniform3f(loc, val.x, val.y, val.z);
   }
@@ -293,7 +543,7 @@ void GLSLShader::SetUniform(GLchar const *name, glm::vec3 const& val) {
 }
 
 void GLSLShader::SetUniform(GLchar const *name, glm::vec4 const& val) {
-  GLint loc = glGetUniformLocation(pgm_handle, name);
+  GLint loc = GetUniformLocation(name);
   if (loc >= 0) {
     glUniform4f(loc, val.x, val.y, val.z, val.w);
   }
@@ -303,7 +553,7 @@ void GLSLShader::SetUniform(GLchar const *name, glm::vec4 const& val) {
 }
 
 void GLSLShader::SetUniform(GLchar const *name, glm::mat3 const& val) {
-  GLint loc = glGetUniformLocation(pgm_handle, name);
+  GLint loc = GetUniformLocation(name);
   if (loc >= 0) {
     glUniformMatrix3fv(loc, 1, GL_FALSE, &val[0][0]);
   }
@@ -313,7 +563,7 @@ void GLSLShader::SetUniform(GLchar const *name, glm::mat3 const& val) {
 }
 
 void GLSLShader::SetUniform(GLchar const *name, glm::mat4 const& val) {
-  GLint loc = glGetUniformLocation(pgm_handle, name);
+  GLint loc = GetUniformLocation(name);
   if (loc >= 0) {
     glUniformMatrix4fv(loc, 1, GL_FALSE, &val[0][0]);
   }
@@ -322,6 +572,73 @@ void GLSLShader::SetUniform(GLchar const *name, glm::mat4 const& val) {
   }
 }
 
+void GLSLShader::SetUniform(GLint handle, GLboolean val) {
+  if (handle >= 0) {
+    glUniform1i(handle, val);
+  }
+}
+
+void GLSLShader::SetUniform(GLint handle, GLint val) {
+  if (handle >= 0) {
+    glUniform1i(handle, val);
+  }
+}
+
+void GLSLShader::SetUniform(GLint handle, GLfloat val) {
+  if (handle >= 0) {
+    glUniform1f(handle, val);
+  }
+}
+
+void GLSLShader::SetUniform(GLint handle, GLfloat x, GLfloat y) {
+  if (handle >= 0) {
+    glUniform2f(handle, x, y);
+  }
+}
+
+void GLSLShader::SetUniform(GLint handle, GLfloat x, GLfloat y, GLfloat z) {
+  if (handle >= 0) {
+    glUniform3f(handle, x, y, z);
+  }
+}
+
+void
+GLSLShader::SetUniform(GLint handle, GLfloat x, GLfloat y, GLfloat z, GLfloat w) {
+  if (handle >= 0) {
+    glUniform4f(handle, x, y, z, w);
+  }
+}
+
+void GLSLShader::SetUniform(GLint handle, glm::vec2 const& val) {
+  if (handle >= 0) {
+    glUniform2f(handle, val.x, val.y);
+  }
+}
+
+void GLSLShader::SetUniform(GLint handle, glm::vec3 const& val) {
+  if (handle >= 0) {
+    glUniform3f(handle, val.x, val.y, val.z);
+  }
+}
+
+void GLSLShader::SetUniform(GLint handle, glm::vec4 const& val) {
+  if (handle >= 0) {
+    glUniform4f(handle, val.x, val.y, val.z, val.w);
+  }
+}
+
+void GLSLShader::SetUniform(GLint handle, glm::mat3 const& val) {
+  if (handle >= 0) {
+    glUniformMatrix3fv(handle, 1, GL_FALSE, &val[0][0]);
+  }
+}
+
+void GLSLShader::SetUniform(GLint handle, glm::mat4 const& val) {
+  if (handle >= 0) {
+    glUniformMatrix4fv(handle, 1, GL_FALSE, &val[0][0]);
+  }
+}
+
 void GLSLShader::PrintActiveAttribs() const {
 #if 1
   GLint max_length, num_attribs;
@@ -0,0 +1,175 @@
+/*!
+@file		glthreadpool.cpp
+@author		benjaminzhiyuan.lee@digipen.edu
+@date		17/10/2026
+
+This file implements structure GLThreadPool. Workers are created once and
+are woken up by a condition variable every time parallel_for() publishes a
+new job; job indices are distributed through an atomic counter.
+
+*//*__________________________________________________________________________*/
+
+/*                                                                   includes
+----------------------------------------------------------------------------- */
+#include <glthreadpool.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*                                                   objects with file scope
+----------------------------------------------------------------------------- */
+namespace
+{
+    std::vector<std::thread> workers;
+    std::mutex mtx;
+    std::condition_variable cv_start;   // signalled when a job is published
+    std::condition_variable cv_done;    // signalled when last worker finishes
+
+    std::function<void(GLuint, GLuint)> const* current_job{ nullptr };
+    GLuint job_count{};
+    GLuint busy_workers{};
+    std::uint64_t generation{};         // incremented for every published job
+    bool quit{ false };
+    std::atomic<GLuint> next_index{};
+
+    /**
+    @brief Executes job indices until the shared counter runs past count.
+
+    @param job The job to invoke.
+    @param count Number of indices in the job.
+    @param worker Index of the calling thread.
+    */
+    void run_indices(std::function<void(GLuint, GLuint)> const& job, GLuint count, GLuint worker)
+    {
+        for (GLuint i = next_index.fetch_add(1); i < count; i = next_index.fetch_add(1))
+        {
+            job(i, worker);
+        }
+    }
+
+    /**
+    @brief Body of every worker thread.
+    Sleeps until a new job generation is published, helps execute it and then
+    reports completion to the thread blocked in parallel_for().
+
+    @param worker Index of this worker in range [1, GLThreadPool::size()).
+    */
+    void worker_loop(GLuint worker)
+    {
+        std::uint64_t seen = 0;
+        for (;;)
+        {
+            std::function<void(GLuint, GLuint)> const* job;
+            GLuint count;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv_start.wait(lock, [&seen] { return quit || generation != seen; });
+                if (quit)
+                {
+                    return;
+                }
+                seen = generation;
+                job = current_job;
+                count = job_count;
+            }
+
+            run_indices(*job, count, worker);
+
+            std::lock_guard<std::mutex> lock(mtx);
+            if (--busy_workers == 0)
+            {
+                cv_done.notify_one();
+            }
+        }
+    }
+}
+
+/**
+@brief Spawns the worker threads.
+
+@param thread_cnt Total number of threads including the caller of
+parallel_for(). A value of 0 uses std::thread::hardware_concurrency().
+*/
+void GLThreadPool::init(GLuint thread_cnt)
+{
+    if (!workers.empty())
+    {
+        return;
+    }
+    if (thread_cnt == 0)
+    {
+        thread_cnt = std::thread::hardware_concurrency();
+    }
+    quit = false;
+    for (GLuint i = 1; i < thread_cnt; ++i)
+    {
+        workers.emplace_back(worker_loop, i);
+    }
+}
+
+/**
+@brief Wakes up all worker threads, asks them to exit and joins them.
+*/
+void GLThreadPool::cleanup()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        quit = true;
+    }
+    cv_start.notify_all();
+    for (std::thread& t : workers)
+    {
+        t.join();
+    }
+    workers.clear();
+}
+
+/**
+@brief Returns the number of threads that execute parallel_for().
+*/
+GLuint GLThreadPool::size()
+{
+    return static_cast<GLuint>(workers.size()) + 1;
+}
+
+/**
+@brief Executes job(index, worker) for every index in [0, count).
+The calling thread works alongside the pool and the function returns once
+every index has been processed.
+
+@param count Number of indices to process.
+@param job The function to invoke for every index.
+*/
+void GLThreadPool::parallel_for(GLuint count, std::function<void(GLuint, GLuint)> const& job)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    if (workers.empty() || count == 1)
+    {
+        for (GLuint i = 0; i < count; ++i)
+        {
+            job(i, 0);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        current_job = &job;
+        job_count = count;
+        next_index = 0;
+        busy_workers = static_cast<GLuint>(workers.size());
+        ++generation;
+    }
+    cv_start.notify_all();
+
+    run_indices(job, count, 0);
+
+    std::unique_lock<std::mutex> lock(mtx);
+    cv_done.wait(lock, [] { return busy_workers == 0; });
+}
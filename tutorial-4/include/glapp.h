@@ -18,7 +18,7 @@ and transformations (in later labs).
 *//*__________________________________________________________________________*/
 
 #include <glslshader.h>
-#include <list>
+#include <glslotmap.h>
 #include <GLFW/glfw3.h>
 
 /*                                                                      guard
@@ -46,26 +46,50 @@ struct GLApp
 	  void release(); // return buffers back to GPU ...
   };
 
-  struct GLObject {
-	  std::string name{};
-	  glm::vec2 scaling{ };
-	  glm::vec2 orientation{};
-	  glm::vec2 position{};
-	  glm::vec3 color{};
-	  glm::mat3 mdl_xform{}; // model (model-to-world) transform
-	  glm::mat3 mdl_to_ndc_xform{}; // model-to-NDC transform
-	  std::map<std::string, GLApp::GLModel>::iterator mdl_ref;
-	  std::map<std::string, GLSLShader>::iterator shd_ref;
+  // objects as a structure of arrays: element i of every array belongs to
+  // the object at dense index i. Objects are referred to by handles that
+  // survive the removal of other objects, and by name through a side index.
+  struct GLObjects {
+	  std::vector<std::string> name;
+	  std::vector<glm::vec2> scaling;
+	  std::vector<glm::vec2> orientation; // x: angle, y: angular speed
+	  std::vector<glm::vec2> position;
+	  std::vector<glm::vec3> color;
+	  std::vector<glm::mat3> mdl_xform; // model (model-to-world) transform
+	  std::vector<std::map<std::string, GLApp::GLModel>::iterator> mdl_ref;
+	  std::vector<std::map<std::string, GLSLShader>::iterator> shd_ref;
+	  // handles of uniforms uModel_to_World and uColor in shader program
+	  // shd_ref - looked up once when the scene is loaded so that draw()
+	  // makes no string lookups
+	  std::vector<GLint> mdl_xform_loc, color_loc;
+	  GLSlotMap slots; // handles of the objects
+	  std::unordered_map<std::string, GLSlotMap::Handle> by_name; // side index
+
+	  size_t size() const;
+	  // add an object named obj_name with zeroed attributes - an existing
+	  // object of that name is replaced
+	  GLSlotMap::Handle add(std::string const& obj_name);
+	  // remove the object of handle h - the last object takes its place
+	  void remove(GLSlotMap::Handle h);
+	  // handle of the object named obj_name - invalid if there is none
+	  GLSlotMap::Handle find(std::string const& obj_name) const;
+	  // dense index of the object of valid handle h
+	  size_t index(GLSlotMap::Handle h) const;
 	  // you can implement them as in tutorial 3 ...
-	  void init();
-	  void draw() const;
-	  //void update();
-	  void update(GLdouble delta_time);
+	  void init(size_t i);
+	  void draw(size_t i) const;
+	  void update(size_t i, GLdouble delta_time);
+
+	  // apply f to every array
+	  template <typename F> void for_each_array(F f) {
+		  f(name); f(scaling); f(orientation); f(position); f(color); f(mdl_xform);
+		  f(mdl_ref); f(shd_ref); f(mdl_xform_loc); f(color_loc);
+	  }
   };
 
   static std::map<std::string, GLSLShader> shdrpgms; // singleton
   static std::map<std::string, GLModel> models; // singleton
-  static std::map<std::string, GLObject> objects; // singleton
+  static GLObjects objects; // singleton
 
   // function to insert shader program into container GLApp::shdrpgms ...
   static void init_shdrpgms(std::string, std::string, std::string);
@@ -74,9 +98,14 @@ struct GLApp
 
 
   struct Camera2D {
-	  GLObject* pgo{}; // pointer to game object that embeds camera
+	  GLSlotMap::Handle pgo{}; // handle to game object that embeds camera
 	  glm::vec2 right{}, up{};
 	  glm::mat3 view_xform{}, camwin_to_ndc_xform{}, world_to_ndc_xform{};
+	  // world_to_ndc_xform is read by every shader program from uniform
+	  // block Camera in this buffer, bound to binding point ubo_binding
+	  static GLuint const ubo_binding = 0;
+	  GLSLUniformBuffer ubo;
+	  GLSLShader::UniformInfo world_to_ndc_info{}; // member uWorld_to_NDC
 	  // window parameters ...
 	  GLint height{ 1000 };
 	  GLfloat ar{};
@@ -95,8 +124,10 @@ struct GLApp
 	  GLboolean right_turn_flag{ GL_FALSE }; // button K
 	  GLboolean move_flag{ GL_FALSE }; // button U
 	  // you can implement these functions as you wish ...
-	  void init(GLFWwindow* win, GLObject* ptr);
+	  void init(GLFWwindow* win, GLSlotMap::Handle obj);
 	  void update(GLFWwindow*);
+	  // write world_to_ndc_xform to the uniform buffer
+	  void upload();
   };
   // define object of type Camera2D ...
   static Camera2D cam;
@@ -0,0 +1,70 @@
+/* !
+@file    glslotmap.h
+@author  benjaminzhiyuan.lee@digipen.edu
+@date    17/10/2026
+
+This file contains the declaration of class GLSlotMap that hands out stable
+handles to objects whose data is kept in packed arrays (a structure of
+arrays). The map only tracks which dense array index each handle refers to;
+the arrays themselves belong to the user, who moves their elements as
+directed whenever objects are removed.
+*//*__________________________________________________________________________*/
+
+/*                                                                      guard
+----------------------------------------------------------------------------- */
+#ifndef GLSLOTMAP_H
+#define GLSLOTMAP_H
+
+/*                                                                   includes
+----------------------------------------------------------------------------- */
+#include <GL/glew.h> // for GLuint and GLboolean
+#include <vector>
+
+/*  _________________________________________________________________________ */
+class GLSlotMap
+/*! GLSlotMap class maps handles to dense indices in [0, size()).
+A handle names a slot and the generation of the slot when the handle was
+handed out. Removing an object bumps the generation of its slot, so handles
+to removed objects are detected as invalid even after the slot is reused.
+*/
+{
+public:
+	struct Handle {
+		GLuint slot;
+		GLuint generation;
+	};
+
+	// number of objects - the length of every packed array
+	GLuint size() const;
+
+	// hand out handles for count new objects at dense indices
+	// [size(), size() + count) - returns the first of these indices
+	GLuint add(GLuint count);
+
+	// is h a handle to an object that has not been removed?
+	GLboolean valid(Handle h) const;
+
+	// dense index of the object of valid handle h
+	GLuint index(Handle h) const;
+
+	// handle to the object at dense index i
+	Handle handle(GLuint i) const;
+
+	// remove the object of valid handle h by swap-remove: the caller must
+	// move the element at dense index size() - 1 (before the call) to the
+	// returned index and then shrink its arrays by one
+	GLuint remove(Handle h);
+
+private:
+	static GLuint const none = ~0u;
+
+	std::vector<GLuint> dense_slot;      // dense index -> slot
+	std::vector<GLuint> slot_dense;      // slot -> dense index, or next free slot
+	std::vector<GLuint> slot_generation; // slot -> current generation
+	GLuint free_slot = none;             // first of the list of free slots
+
+	// put slot on the free list, invalidating its handles
+	void release(GLuint slot);
+};
+
+#endif /* GLSLOTMAP_H */
@@ -28,7 +28,7 @@ to OpenGL implementations.
 // define singleton containers
 std::map<std::string, GLSLShader> GLApp::shdrpgms;
 std::map<std::string, GLApp::GLModel> GLApp::models;
-std::map<std::string, GLApp::GLObject> GLApp::objects;
+GLApp::GLObjects GLApp::objects;
 GLApp::Camera2D GLApp::cam;
 
 //enumaration for raster mode
@@ -57,11 +57,16 @@ void GLApp::init() {
 	// and store repositories of models of type GLModel in container
 	// GLApp::models, store shader programs of type GLSLShader in
 	// container GLApp::shdrpgms, and store repositories of objects of
-	// type GLObject in container GLApp::objects
+	// the objects in the arrays of GLApp::objects
 	GLApp::init_scene("../scenes/tutorial-4.scn");
 	// Part 4: initialize camera
 	// explained in a later section ...
-	cam.init(GLHelper::ptr_window, &objects.at("Camera"));
+	GLSlotMap::Handle camera = objects.find("Camera");
+	if (!objects.slots.valid(camera)) {
+		std::cout << "ERROR: Scene has no object named Camera\n";
+		std::exit(EXIT_FAILURE);
+	}
+	cam.init(GLHelper::ptr_window, camera);
 }
 
 /**
@@ -75,9 +80,10 @@ void GLApp::update()
 {
 	cam.update(GLHelper::ptr_window);
 
-	for (auto& [key, val] : objects) {
-		if (key == "Camera") continue;
-		val.update(GLHelper::delta_time);
+	size_t const cam_obj = objects.index(cam.pgo);
+	for (size_t i = 0; i < objects.size(); ++i) {
+		if (i == cam_obj) continue;
+		objects.update(i, GLHelper::delta_time);
 	}
 
 	if (GLHelper::keystateP == GL_TRUE)
@@ -117,10 +123,11 @@ void GLApp::draw()
 	// separate each piece of information using " | "
 	// see sample executable for example ...
 	// Print to window title bar
+	size_t const cam_obj = objects.index(cam.pgo);
 	std::stringstream cam_pos{};
-	cam_pos << std::fixed << std::setprecision(2) << "(" << objects["Camera"].position.x << ", " << objects["Camera"].position.y << ")";
+	cam_pos << std::fixed << std::setprecision(2) << "(" << objects.position[cam_obj].x << ", " << objects.position[cam_obj].y << ")";
 	std::stringstream cam_orientation{};
-	cam_orientation << "Orientation: " << objects["Camera"].orientation.x << " degrees";
+	cam_orientation << "Orientation: " << objects.orientation[cam_obj].x << " degrees";
 	std::stringstream window_height{};
 	window_height << "Window height: " << cam.height;
 	std::stringstream fps{};
@@ -152,16 +159,16 @@ void GLApp::draw()
 	}
 
 	// Part 4: Render each object in container GLApp::objects
-	for (auto const& [key,val] : GLApp::objects) 
+	for (size_t i = 0; i < objects.size(); ++i)
 	{	
-		if (key == "Camera")
+		if (i == cam_obj)
 		{
 			continue;
 		}
-		val.draw(); // call member function GLObject::draw()
+		objects.draw(i); // call member function GLObjects::draw()
 	}
 	//render camera
-	objects["Camera"].draw();
+	objects.draw(cam_obj);
 }
 
 /**
@@ -175,6 +182,7 @@ It is recommended to call this function before exiting the GLApp to properly cle
 */
 void GLApp::cleanup() 
 {
+	cam.ubo.Destroy();
 	models["triangle"].release();
 	models["square"].release();
 	models["circle"].release();
@@ -220,9 +228,10 @@ void GLApp::init_scene(std::string scene_filename)
 
 		//get model name
 		getline(ifs, line);
-		GLObject obj{};
 		std::istringstream line_objname{ line };
-		line_objname >> obj.name;
+		std::string obj_name;
+		line_objname >> obj_name;
+		size_t const obj = objects.index(objects.add(obj_name));
 
 		//get shader program name and init shader program if not found
 		getline(ifs, line);
@@ -239,28 +248,39 @@ void GLApp::init_scene(std::string scene_filename)
 		//get color of object
 		getline(ifs, line);
 		std::istringstream line_color{ line };
-		line_color >> obj.color[0] >> obj.color[1] >> obj.color[2];
+		line_color >> objects.color[obj][0] >> objects.color[obj][1] >> objects.color[obj][2];
 
 		//get scale of object
 		getline(ifs, line);
 		std::istringstream line_scale{ line };
-		line_scale >> obj.scaling.x >> obj.scaling.y;
+		line_scale >> objects.scaling[obj].x >> objects.scaling[obj].y;
 
 		//get angular disp and angular speed of object
 		getline(ifs, line);
 		std::istringstream line_orientation{ line };
-		line_orientation >> obj.orientation.x >> obj.orientation.y;
+		line_orientation >> objects.orientation[obj].x >> objects.orientation[obj].y;
 
 		//get position of object
 		getline(ifs, line);
 		std::istringstream line_position{ line };
-		line_position >> obj.position.x >> obj.position.y;
+		line_position >> objects.position[obj].x >> objects.position[obj].y;
 
 		//set mdl_ref and shd_ref
-		obj.mdl_ref = models.find(model_name);
-		obj.shd_ref = shdrpgms.find(shdrpgm_name);
+		objects.mdl_ref[obj] = models.find(model_name);
+		objects.shd_ref[obj] = shdrpgms.find(shdrpgm_name);
+
+		//look up the handles of the object's uniforms once
+		objects.mdl_xform_loc[obj] = objects.shd_ref[obj]->second.GetUniformHandle("uModel_to_World");
+		objects.color_loc[obj] = objects.shd_ref[obj]->second.GetUniformHandle("uColor");
+		if (objects.mdl_xform_loc[obj] < 0) {
+			std::cout << "Uniform variable 1 doesn't exist\n";
+			std::exit(EXIT_FAILURE);
+		}
+		if (objects.color_loc[obj] < 0) {
+			std::cout << "Uniform variable 2 doesn't exist\n";
+			std::exit(EXIT_FAILURE);
+		}
 
-		objects[obj.name] = obj;
 	}
 }
 
@@ -268,7 +288,8 @@ void GLApp::init_scene(std::string scene_filename)
  * @brief Initialize a shader program.
  *
  * This function compiles, links, and validates a shader program using the
- * provided vertex and fragment shader source code. It adds the compiled,
+ * provided vertex and fragment shader source code. It connects the program's
+ * uniform block Camera to the camera's uniform buffer and adds the compiled,
  * linked, and validated shader program to the GLApp::shdrpgms map container.
  *
  * @param shdr_pgm_name The name to associate with the shader program.
@@ -288,6 +309,9 @@ void GLApp::init_shdrpgms(std::string shdr_pgm_name, std::string vtx_shdr, std::
 		std::cout << shdr_pgm.GetLog() << "\n";
 		std::exit(EXIT_FAILURE);
 	}
+	if (GL_FALSE == shdr_pgm.BindUniformBlock("Camera", Camera2D::ubo_binding)) {
+		std::exit(EXIT_FAILURE);
+	}
 	// add compiled, linked, and validated shader program to
 	// std::map container GLApp::shdrpgms
 	GLApp::shdrpgms[shdr_pgm_name] = shdr_pgm;
@@ -384,32 +408,46 @@ void GLApp::GLModel::init(std::string model_file_name)
  * @brief Initialize the 2D camera with the given window and object parameters.
  *
  * This function initializes the 2D camera by calculating various transformation matrices
- * based on the provided window and object parameters.
+ * based on the provided window and object parameters. It also creates the uniform buffer
+ * read by uniform block Camera, sized and laid out as reflected from the shader program
+ * of the camera's object; std140 gives the block the same layout in every program.
  *
  * @param win The GLFW window object.
- * @param ptr Pointer to the GLObject representing the camera's target.
+ * @param obj Handle to the object representing the camera's target.
  */
-void GLApp::Camera2D::init(GLFWwindow* win, GLApp::GLObject* ptr) 
+void GLApp::Camera2D::init(GLFWwindow* win, GLSlotMap::Handle obj) 
 {
-	pgo = ptr;
+	pgo = obj;
+	size_t const i = objects.index(pgo);
 
 	GLsizei fb_width{}, fb_height{};
 	glfwGetFramebufferSize(win, &fb_width, &fb_height);
 	ar = static_cast<GLfloat>(fb_width) / fb_height;
 
-	GLfloat rad = glm::radians(pgo->orientation.x);
+	GLfloat rad = glm::radians(objects.orientation[i].x);
 	up = glm::vec2{ -sin(rad), cos(rad) };
 	right = glm::vec2{ cos(rad), sin(rad) };
 
 	view_xform = { glm::vec3{1, 0, 0},
 				   glm::vec3{0, 1, 0},
-				   glm::vec3{-pgo->position.x, -pgo->position.y, 1} };
+				   glm::vec3{-objects.position[i].x, -objects.position[i].y, 1} };
 
 	camwin_to_ndc_xform = { glm::vec3{2.f / static_cast<float>(fb_width), 0, 0},
 							glm::vec3{0, 2.f / static_cast<float>(fb_height), 0},
 							glm::vec3{0, 0, 1} };
 
 	world_to_ndc_xform = camwin_to_ndc_xform * view_xform;
+
+	GLSLShader const& shdr_pgm = objects.shd_ref[i]->second;
+	GLSLShader::UniformBlockInfo const* block = shdr_pgm.GetUniformBlockInfo("Camera");
+	GLSLShader::UniformInfo const* member = shdr_pgm.GetUniformInfo("uWorld_to_NDC");
+	if (!block || !member || GL_FALSE == ubo.Create(block->data_size)) {
+		std::cout << "ERROR: Unable to set up uniform block Camera\n";
+		std::exit(EXIT_FAILURE);
+	}
+	world_to_ndc_info = *member;
+	ubo.Bind(ubo_binding);
+	upload();
 }
 
 /**
@@ -422,6 +460,7 @@ void GLApp::Camera2D::init(GLFWwindow* win, GLApp::GLObject* ptr)
  * @param win The GLFW window object.
  */
 void GLApp::Camera2D::update(GLFWwindow*) {
+	size_t const i = objects.index(pgo);
 	left_turn_flag = GLHelper::keystateH;
 	right_turn_flag = GLHelper::keystateK;
 	move_flag = GLHelper::keystateU;
@@ -436,21 +475,21 @@ void GLApp::Camera2D::update(GLFWwindow*) {
 	if (left_turn_flag || right_turn_flag) {
 		
 		if (left_turn_flag) {
-			pgo->orientation.x += pgo->orientation.y;
-			if (pgo->orientation.x > 360.f) pgo->orientation.x = 0.f;
+			objects.orientation[i].x += objects.orientation[i].y;
+			if (objects.orientation[i].x > 360.f) objects.orientation[i].x = 0.f;
 		}
 		else {
-			pgo->orientation.x -= pgo->orientation.y;
-			if (pgo->orientation.x < -360.f) pgo->orientation.x = 0.f;
+			objects.orientation[i].x -= objects.orientation[i].y;
+			if (objects.orientation[i].x < -360.f) objects.orientation[i].x = 0.f;
 		}
 
-		GLfloat rad = glm::radians(pgo->orientation.x);
+		GLfloat rad = glm::radians(objects.orientation[i].x);
 		up = glm::vec2{ -sin(rad), cos(rad) };
 		right = glm::vec2{ cos(rad), sin(rad) };
 	}
 
 	if (move_flag) {
-		pgo->position = pgo->position + (linear_speed * up);
+		objects.position[i] = objects.position[i] + (linear_speed * up);
 	}
 
 	if (zoom_flag) {
@@ -468,17 +507,17 @@ void GLApp::Camera2D::update(GLFWwindow*) {
 	if (camtype_flag) {
 		view_xform = { glm::vec3{1, 0, 0},
 					   glm::vec3{0, 1, 0},
-					   glm::vec3{-pgo->position.x, -pgo->position.y, 1} };
+					   glm::vec3{-objects.position[i].x, -objects.position[i].y, 1} };
 	}
 	else {
 		view_xform = { glm::vec3{right.x, up.x, 0},
 					   glm::vec3{right.y, up.y, 0},
-					   glm::vec3{-(glm::dot(right,pgo->position)), -(glm::dot(up,pgo->position)), 1} };
+					   glm::vec3{-(glm::dot(right,objects.position[i])), -(glm::dot(up,objects.position[i])), 1} };
 	}
 
-	GLfloat angle_rad = glm::radians(pgo->orientation.x);
-	glm::mat3 scale_mtx = { glm::vec3{pgo->scaling.x, 0, 0},
-							glm::vec3{0, pgo->scaling.y, 0},
+	GLfloat angle_rad = glm::radians(objects.orientation[i].x);
+	glm::mat3 scale_mtx = { glm::vec3{objects.scaling[i].x, 0, 0},
+							glm::vec3{0, objects.scaling[i].y, 0},
 							glm::vec3{0, 0, 1} };
 
 	glm::mat3 rot_mtx = { glm::vec3{cos(angle_rad), sin(angle_rad), 0},
@@ -487,17 +526,29 @@ void GLApp::Camera2D::update(GLFWwindow*) {
 
 	glm::mat3 trans_mtx = { glm::vec3{1, 0, 0},
 							glm::vec3{0, 1, 0},
-							glm::vec3{pgo->position.x, pgo->position.y, 1} };
+							glm::vec3{objects.position[i].x, objects.position[i].y, 1} };
 
-	pgo->mdl_xform = trans_mtx * rot_mtx * scale_mtx;
+	objects.mdl_xform[i] = trans_mtx * rot_mtx * scale_mtx;
 
 	camwin_to_ndc_xform = { glm::vec3{2.f / static_cast<GLfloat>(height * ar), 0, 0},
 							glm::vec3{0, 2.f / static_cast<GLfloat>(height), 0},
 							glm::vec3{0, 0, 1} };
 
 	world_to_ndc_xform = camwin_to_ndc_xform * view_xform;
+	upload();
+}
 
-	pgo->mdl_to_ndc_xform = world_to_ndc_xform * pgo->mdl_xform;
+/**
+ * @brief Write the world-to-NDC transform to the camera's uniform buffer.
+ *
+ * The matrix is written at the offset and matrix stride reflected for member
+ * uWorld_to_NDC and uploaded with a single buffer update, which every shader
+ * program then reads for the rest of the frame.
+ */
+void GLApp::Camera2D::upload()
+{
+	ubo.Set(world_to_ndc_info, world_to_ndc_xform);
+	ubo.Upload();
 }
 
 /**
@@ -514,16 +565,86 @@ void GLApp::GLModel::release()
 }
 
 /**
- * @brief Initialize the GLObject with random parameters.
+ * @brief Return the number of objects.
+ */
+size_t GLApp::GLObjects::size() const
+{
+	return slots.size();
+}
+
+/**
+ * @brief Add an object.
+ *
+ * The object is appended to every array and entered into the name index.
+ * An object that already has the name is removed first, as assigning to
+ * the map the objects used to be kept in would replace it.
+ *
+ * @param obj_name The name of the object.
+ * @return The handle to the new object.
+ */
+GLSlotMap::Handle GLApp::GLObjects::add(std::string const& obj_name)
+{
+	remove(find(obj_name));
+	size_t i = slots.add(1);
+	for_each_array([i](auto& array) { array.resize(i + 1); });
+	name[i] = obj_name;
+	mdl_xform_loc[i] = color_loc[i] = -1;
+	return by_name[obj_name] = slots.handle(static_cast<GLuint>(i));
+}
+
+/**
+ * @brief Remove an object.
+ *
+ * The last object is moved into the place of the removed one, so the
+ * arrays stay packed. Invalid handles are ignored.
+ *
+ * @param h The handle to the object.
+ */
+void GLApp::GLObjects::remove(GLSlotMap::Handle h)
+{
+	if (!slots.valid(h)) {
+		return;
+	}
+	by_name.erase(name[slots.index(h)]);
+	size_t i = slots.remove(h);
+	for_each_array([i](auto& array) {
+		array[i] = std::move(array.back());
+		array.pop_back();
+	});
+}
+
+/**
+ * @brief Look an object up by name.
+ *
+ * @param obj_name The name of the object.
+ * @return The handle to the object, or a handle that is not valid if no
+ * object has the name.
+ */
+GLSlotMap::Handle GLApp::GLObjects::find(std::string const& obj_name) const
+{
+	auto it = by_name.find(obj_name);
+	return it == by_name.end() ? GLSlotMap::Handle{ ~0u, ~0u } : it->second;
+}
+
+/**
+ * @brief Return the dense index of the object of a valid handle.
+ */
+size_t GLApp::GLObjects::index(GLSlotMap::Handle h) const
+{
+	return slots.index(h);
+}
+
+/**
+ * @brief Initialize an object with random parameters.
  *
- * This function initializes the GLObject by assigning random values to its parameters.
+ * This function initializes the object at dense index i by assigning random values to its parameters.
  * It randomly chooses between two model data options, sets the shader reference to 0,
  * and generates random values for position, scaling, rotation speed, and initial orientation.
  * The position is set between -1 and 1 in both X and Y coordinates, scaling is randomly
  * generated within a specified range, and the rotation speed and initial orientation
  * are assigned random float values.
  */
-void GLApp::GLObject::init()
+void GLApp::GLObjects::init(size_t i)
 {
 	/*double const range_x = GLHelper::width;
 	double const range_y = GLHelper::height;*/
@@ -542,101 +663,74 @@ void GLApp::GLObject::init()
 
 	//set random position between -1.f and 1.f
 	std::uniform_real_distribution<> dis_coordinate(-1.f, 1.f);
-	position = glm::vec2(dis_coordinate(mystery), dis_coordinate(mystery));
+	position[i] = glm::vec2(dis_coordinate(mystery), dis_coordinate(mystery));
 
 	//Initialise objects scale, rotation
 	std::uniform_real_distribution<> dis_scale(0.05, 0.15);		//random scale
-	scaling = glm::vec2(dis_scale(mystery), dis_scale(mystery));
-	orientation.y = static_cast<float>(dis_float(mystery));			//random rotation speed
-	orientation.x = static_cast<float>(dis_float(mystery)) * 360.f;	//current orientation
+	scaling[i] = glm::vec2(dis_scale(mystery), dis_scale(mystery));
+	orientation[i].y = static_cast<float>(dis_float(mystery));			//random rotation speed
+	orientation[i].x = static_cast<float>(dis_float(mystery)) * 360.f;	//current orientation
 }
 
 /**
- * @brief Draw the GLObject using the assigned shader program and transformation matrices.
+ * @brief Draw an object using the assigned shader program and transformation matrices.
  *
- * This function draws the GLObject by performing the following steps:
+ * This function draws the object at dense index i by performing the following steps:
  * 1. Binds the assigned shader program.
  * 2. Binds the vertex array object (VAO) of the assigned model data.
- * 3. Retrieves the uniform variable location for the "uModel_to_NDC" matrix in the shader program.
- * 4. Sets the uniform variable value to the transformation matrix representing the model-to-NDC coordinate space.
- * 5. Retrieves the uniform variable location for the "uColor" vector in the shader program.
- * 6. Sets the uniform variable value to the color of the GLObject.
- * 7. Draws the model using the specified primitive type and draw count.
- * 8. Unbinds the VAO.
- * 9. Unbinds the shader program.
+ * 3. Sets the "uModel_to_World" uniform to the model transformation matrix; the world-to-NDC
+ *    transform is read from the camera's uniform buffer.
+ * 4. Sets the "uColor" uniform to the color of the object.
+ * 5. Draws the model using the specified primitive type and draw count.
+ * 6. Unbinds the VAO.
+ * 7. Unbinds the shader program.
  *
- * If the uniform variable locations are not found in the shader program,
- * an error message is printed, and the program exits.
+ * Both uniforms are set through the handles looked up when the scene was
+ * loaded, so no uniform names are resolved per frame.
  */
-void GLApp::GLObject::draw() const
+void GLApp::GLObjects::draw(size_t i) const
 {	
-	shd_ref->second.Use();
+	shd_ref[i]->second.Use();
 
-	glBindVertexArray(mdl_ref->second.vaoid);
+	glBindVertexArray(mdl_ref[i]->second.vaoid);
 
-	GLint uniform_var_loc1 = glGetUniformLocation(shd_ref->second.GetHandle(), "uModel_to_NDC");
+	// handles were looked up when the scene was loaded
+	shd_ref[i]->second.SetUniform(mdl_xform_loc[i], mdl_xform[i]);
+	shd_ref[i]->second.SetUniform(color_loc[i], color[i]);
 
-	if (uniform_var_loc1 >= 0) {
-		glUniformMatrix3fv(uniform_var_loc1, 1, GL_FALSE, glm::value_ptr(mdl_to_ndc_xform));
-	}
-	else {
-		std::cout << "Uniform variable 1 doesn't exist\n";
-		std::exit(EXIT_FAILURE);
-	}
-
-	GLint uniform_var_loc2 = glGetUniformLocation(shd_ref->second.GetHandle(), "uColor");
-
-	if (uniform_var_loc2 >= 0) {
-		glUniform3fv(uniform_var_loc2, 1, glm::value_ptr(color));
-	}
-	else {
-		std::cout << "Uniform variable 2 doesn't exist\n";
-		std::exit(EXIT_FAILURE);
-	}
-
-	//glVertexAttrib3f(1, color.r, color.g, color.b);
-	glDrawElements(mdl_ref->second.primitive_type, mdl_ref->second.draw_cnt, GL_UNSIGNED_SHORT, NULL);
-	//glDrawArrays(mdl_ref->second.primitive_type, 0, mdl_ref->second.draw_cnt);
+	//glVertexAttrib3f(1, color[i].r, color[i].g, color[i].b);
+	glDrawElements(mdl_ref[i]->second.primitive_type, mdl_ref[i]->second.draw_cnt, GL_UNSIGNED_SHORT, NULL);
+	//glDrawArrays(mdl_ref[i]->second.primitive_type, 0, mdl_ref[i]->second.draw_cnt);
 
 	glBindVertexArray(0);
 
-	shd_ref->second.UnUse();
+	shd_ref[i]->second.UnUse();
 }
 
 /**
- * @brief Update the GLObject based on the elapsed time.
+ * @brief Update an object based on the elapsed time.
+ *
+ * This function updates the object at dense index i by performing the following steps:
+ * 1. Updates the orientation.x value by adding the product of orientation.y and delta_time.
+ * 2. Converts the orientation.x value to radians and computes its sine and cosine once.
+ * 3. Builds the model transformation matrix translation * rotation * scale directly: its
+ *    columns are the columns of the rotation scaled by the object's scaling, and the position.
  *
- * This function updates the GLObject by performing the following steps:
- * 1. Calculates the scale, translation, and rotation matrices based on the current parameters.
- * 2. Updates the orientation.x value by adding the product of orientation.y and delta_time.
- * 3. Converts the orientation.x value to radians.
- * 4. Calculates the rotation matrix based on the converted orientation.x value.
- * 5. Calculates the model transformation matrix by combining the scale, translation, and rotation matrices.
- * 6. Calculates the model-to-NDC transformation matrix by multiplying the world-to-NDC transformation matrix
- *    with the model transformation matrix.
+ * The world-to-NDC transform is applied by the vertex shader, which reads it from the
+ * camera's uniform buffer.
  *
+ * @param i The dense index of the object.
  * @param delta_time The elapsed time since the last update, in seconds.
  */
-void GLApp::GLObject::update(GLdouble delta_time)
+void GLApp::GLObjects::update(size_t i, GLdouble delta_time)
 {
-	glm::mat3 scale_mtx{ scaling.x,			0,	0,
-									 0,	scaling.y,	0,
-									 0,			0,	1 };
-
-	glm::mat3 trans_mtx{ 1,			0,0,
-						 0,			1,0,
-				position.x,position.y,1 };
-
-	
-	orientation.x += static_cast<GLfloat>(orientation.y * delta_time);
-	float rad = glm::radians(orientation.x);
-
-	glm::mat3 rot_mtx{ glm::cos(rad), glm::sin(rad), 0,
-					  -glm::sin(rad), glm::cos(rad), 0,
-								   0, 			  0, 1 };
+	orientation[i].x += static_cast<GLfloat>(orientation[i].y * delta_time);
+	float rad = glm::radians(orientation[i].x);
+	float c = glm::cos(rad), s = glm::sin(rad);
 
-	mdl_xform = trans_mtx * rot_mtx * scale_mtx;
-	mdl_to_ndc_xform = cam.world_to_ndc_xform * mdl_xform;
+	mdl_xform[i] = glm::mat3{ c * scaling[i].x, s * scaling[i].x, 0,
+							 -s * scaling[i].y, c * scaling[i].y, 0,
+							 position[i].x, position[i].y, 1 };
 }
 
 
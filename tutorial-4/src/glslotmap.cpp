@@ -0,0 +1,97 @@
+/*!
+@file    glslotmap.cpp
+@author  benjaminzhiyuan.lee@digipen.edu
+@date    17/10/2026
+
+This file implements class GLSlotMap. Free slots are chained through
+slot_dense so that no memory beyond the three index arrays is needed, and
+slots are reused before new ones are appended.
+
+*//*__________________________________________________________________________*/
+
+/*                                                                   includes
+----------------------------------------------------------------------------- */
+#include <glslotmap.h>
+
+GLuint GLSlotMap::size() const
+{
+	return static_cast<GLuint>(dense_slot.size());
+}
+
+/**
+
+@brief Hands out handles for new objects.
+
+Free slots are taken first; once they run out, new slots are appended.
+
+@param count The number of new objects.
+
+@return The dense index of the first new object.
+*/
+GLuint GLSlotMap::add(GLuint count)
+{
+	GLuint first = size();
+	dense_slot.reserve(first + count);
+	for (GLuint i = first; i < first + count; ++i)
+	{
+		GLuint slot = free_slot;
+		if (slot != none)
+		{
+			free_slot = slot_dense[slot];
+		}
+		else
+		{
+			slot = static_cast<GLuint>(slot_dense.size());
+			slot_dense.push_back(0);
+			slot_generation.push_back(0);
+		}
+		slot_dense[slot] = i;
+		dense_slot.push_back(slot);
+	}
+	return first;
+}
+
+GLboolean GLSlotMap::valid(Handle h) const
+{
+	return h.slot < slot_generation.size() && slot_generation[h.slot] == h.generation
+		&& slot_dense[h.slot] < size() && dense_slot[slot_dense[h.slot]] == h.slot;
+}
+
+GLuint GLSlotMap::index(Handle h) const
+{
+	return slot_dense[h.slot];
+}
+
+GLSlotMap::Handle GLSlotMap::handle(GLuint i) const
+{
+	return Handle{ dense_slot[i], slot_generation[dense_slot[i]] };
+}
+
+/**
+
+@brief Removes an object by swap-remove.
+
+The last object takes the dense index of the removed one, so removal costs
+one element move per array regardless of the number of objects.
+
+@param h The handle of the object to remove.
+
+@return The dense index that the last object moves to.
+*/
+GLuint GLSlotMap::remove(Handle h)
+{
+	GLuint i = slot_dense[h.slot];
+	GLuint last = size() - 1;
+	dense_slot[i] = dense_slot[last];
+	slot_dense[dense_slot[i]] = i;
+	dense_slot.pop_back();
+	release(h.slot);
+	return i;
+}
+
+void GLSlotMap::release(GLuint slot)
+{
+	++slot_generation[slot];
+	slot_dense[slot] = free_slot;
+	free_slot = slot;
+}